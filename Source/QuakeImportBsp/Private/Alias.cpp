@@ -2,7 +2,9 @@
 
 // QuakeImport
 #include "Alias.h"
+#include "BspFactory.h"
 #include "QuakeCommon.h"
+#include "ImportStats.h"
 
 // EPIC
 #include "AssetRegistryModule.h"
@@ -19,185 +21,13 @@
 #include "RawMesh/Public/RawMesh.h"
 #include "UObject/Package.h"
 
-Alias::Alias(const FString name, const uint8*& buf) :
-    m_name(name),
-    m_scale(),
-    m_origin(),
-    m_eyePosition(),
-    m_numSkins(0),
-    m_numFrames(0),
-    m_numTris(0)
+namespace
 {
-    // Read model header
-    AliasHeader aliasHeader;
-    QuakeCommon::ReadData<AliasHeader>(buf, 0, aliasHeader);
-
-    m_origin = { aliasHeader.origin[0], aliasHeader.origin[1], aliasHeader.origin[2] };
-    m_scale = { aliasHeader.scale[0], aliasHeader.scale[1], aliasHeader.scale[2] };
-    m_eyePosition = { aliasHeader.offsets[0], aliasHeader.offsets[1], aliasHeader.offsets[2] };
-
-    m_skinWidth = aliasHeader.skinwidth;
-    m_skinHeight = aliasHeader.skinheight;
-    m_numSkins = aliasHeader.numskins;
-    m_numTris = aliasHeader.numtris;
-    m_numFrames = aliasHeader.numframes;
-    m_numVerts = aliasHeader.numverts;
-
-    int skinSize = aliasHeader.skinwidth * aliasHeader.skinheight; // pre calculate total byte size of 1 skin
-
-    // pre allocate storage for our mesh data
-    m_texcoords.SetNum(aliasHeader.numverts);
-    m_triangles.SetNum(aliasHeader.numtris);
-
-    // Predefine position of all our data types in the mdl file
-    // No table exist for this so it must be calculated this way
-    int SKIN_POS = sizeof(AliasHeader);
-    int TEXTURE_VERTS_POS = SKIN_POS + ((sizeof(int) + skinSize) * aliasHeader.numskins);
-    int TRIANGLES_POS = TEXTURE_VERTS_POS + (sizeof(AliasTexcoord) * aliasHeader.numverts);
-    int FRAMES_POS = TRIANGLES_POS + (sizeof(AliasTriangle) * aliasHeader.numtris);
-
-    // SKIN
-
-    m_skins.SetNum(aliasHeader.numskins);
-
-    for (int i = 0; i < aliasHeader.numskins; i++)
-    {
-        int skin_type;
-        SKIN_POS += QuakeCommon::ReadData<int>(buf, SKIN_POS, skin_type);
-
-        if (skin_type == 0)
-        {
-            // STATIC SKIN
-            m_skins[i].data.Append(buf + SKIN_POS, skinSize);
-            SKIN_POS += skinSize;
-        }
-    }
-
-    // TEXTURE COORDINATES
-    for (int i = 0; i < aliasHeader.numverts; i++)
-    {
-        TEXTURE_VERTS_POS += QuakeCommon::ReadData<AliasTexcoord>(buf, TEXTURE_VERTS_POS, m_texcoords[i]);
-    }
-
-    // TRIANGLES
-    for (int i = 0; i < aliasHeader.numtris; i++)
-    {
-        TRIANGLES_POS += QuakeCommon::ReadData<AliasTriangle>(buf, TRIANGLES_POS, m_triangles[i]);
-    }
-
-    // FRAMES
-
-    for (int i = 0; i < aliasHeader.numframes; i++)
-    {
-        int frametype;
-        FRAMES_POS += QuakeCommon::ReadData<int>(buf, FRAMES_POS, frametype);
-
-        if (frametype == 0) // ALIAS_SINGLE_FRAME
-        {
-            AliasFrame frame;
-
-            frame.type = frametype;
-            frame.numposes = 1;
-            frame.firstpose = 0;
-            frame.interval = 0;
-
-            FRAMES_POS += QuakeCommon::ReadData<AliasPoint>(buf, FRAMES_POS, frame.bboxmin);
-            FRAMES_POS += QuakeCommon::ReadData<AliasPoint>(buf, FRAMES_POS, frame.bboxmax);
-
-            AliasFrameName framename;
-            FRAMES_POS += QuakeCommon::ReadData<AliasFrameName>(buf, FRAMES_POS, framename);
-            frame.name = framename.str;
-
-            AliasPose pose(aliasHeader.numverts);
-
-            for (int j = 0; j < aliasHeader.numverts; j++)
-            {
-                FRAMES_POS += QuakeCommon::ReadData<AliasPoint>(
-                    buf,
-                    FRAMES_POS,
-                    pose.points[j]
-                    );
-            }
-
-            frame.firstpose = (int)m_poses.Num();
-            m_poses.Add(pose);
-            m_frames.Add(frame);
-        }
-        else // ALIAS_FRAME_GROUP
-        {
-            AliasFrame frame;
-
-            frame.type = frametype;
-            AliasGroup group;
-            FRAMES_POS += QuakeCommon::ReadData<AliasGroup>(buf, FRAMES_POS, group);
-
-            frame.firstpose = (int)m_poses.Num();
-
-            frame.numposes = group.numframes - frame.firstpose;
-            frame.bboxmin = group.bboxmin;
-            frame.bboxmax = group.bboxmax;
-
-            TArray<float> intervals;
-            intervals.Init(0, group.numframes);
-
-            for (int j = 0; j < group.numframes; j++)
-            {
-                FRAMES_POS += QuakeCommon::ReadData<float>(buf, FRAMES_POS, intervals[j]);
-            }
-
-            frame.interval = intervals[0]; // only use first interval for the frame.
-
-            for (int j = 0; j < group.numframes; j++)
-            {
-                AliasPoint min;
-                AliasPoint max;
-
-                AliasPose pose(aliasHeader.numverts);
-
-                FRAMES_POS += QuakeCommon::ReadData<AliasPoint>(buf, FRAMES_POS, min);
-                FRAMES_POS += QuakeCommon::ReadData<AliasPoint>(buf, FRAMES_POS, max);
-
-                AliasFrameName framename;
-                FRAMES_POS += QuakeCommon::ReadData<AliasFrameName>(buf, FRAMES_POS, framename);
-
-                if (frame.name.IsEmpty())
-                {
-                    frame.name = framename.str;
-                }
-
-                for (int c = 0; c < aliasHeader.numverts; c++)
-                {
-                    FRAMES_POS += QuakeCommon::ReadData<AliasPoint>(
-                        buf,
-                        FRAMES_POS,
-                        pose.points[c]
-                        );
-                }
-
-                m_poses.Add(pose);
-            }
-
-            m_frames.Add(frame);
-        }
-    }
-}
-
-const FVector3f Alias::UnpackVertex(AliasPoint in) const
-{
-    FVector3f out;
-
-    for (int i = 0; i < 3; i++)
-    {
-        out[i] = (m_scale[i] * in.position[i]) + m_origin[i];
-    }
-
-    return out;
-}
-
-const FVector3f Alias::GetNormal(uint32 index) const
-{
-    float normals[162][3] = {
+    constexpr int ALIAS_IDENT = 0x4F504449; // "IDPO"
+    constexpr int ALIAS_VERSION = 6;
 
+    // Quake anorms.h, indexed by AliasPoint::lightnormalindex
+    constexpr float ALIAS_NORMALS[NUM_ALIAS_NORMALS][3] = {
         {-0.525731f, 0.000000f, 0.850651f},
         {-0.442863f, 0.238856f, 0.864188f},
         {-0.295242f, 0.000000f, 0.955423f},
@@ -360,13 +190,449 @@ const FVector3f Alias::GetNormal(uint32 index) const
         {-0.425325f, -0.688191f, -0.587785f},
         {-0.587785f, -0.425325f, -0.688191f},
         {-0.688191f, -0.587785f, -0.425325f},
+    };
+}
 
+Alias::Alias(const FString name, const uint8*& buf, int64 size) :
+    m_name(name),
+    m_scale(),
+    m_origin(),
+    m_eyePosition(),
+    m_numSkins(0),
+    m_numFrames(0),
+    m_numTris(0),
+    m_numVerts(0),
+    m_numPoses(0),
+    m_valid(false)
+{
+    QUAKE_IMPORT_SCOPE("ParseAlias");
+
+    // Every read below is checked against the buffer before it happens
+    auto Fits = [size](int64 position, int64 bytes)
+    {
+        return position >= 0 && bytes >= 0 && position + bytes <= size;
     };
 
-    FVector3f vector(
-        normals[index][0],
-        normals[index][1],
-        normals[index][2]);
+    if (!Fits(0, sizeof(AliasHeader)))
+    {
+        return;
+    }
+
+    // Read model header
+    AliasHeader aliasHeader;
+    QuakeCommon::ReadData<AliasHeader>(buf, 0, aliasHeader);
+
+    if (aliasHeader.id != ALIAS_IDENT || aliasHeader.version != ALIAS_VERSION ||
+        aliasHeader.numskins < 0 || aliasHeader.skinwidth <= 0 || aliasHeader.skinheight <= 0 ||
+        aliasHeader.numverts <= 0 || aliasHeader.numtris < 0 || aliasHeader.numframes <= 0)
+    {
+        return;
+    }
+
+    m_origin = { aliasHeader.origin[0], aliasHeader.origin[1], aliasHeader.origin[2] };
+    m_scale = { aliasHeader.scale[0], aliasHeader.scale[1], aliasHeader.scale[2] };
+    m_eyePosition = { aliasHeader.offsets[0], aliasHeader.offsets[1], aliasHeader.offsets[2] };
+
+    m_skinWidth = aliasHeader.skinwidth;
+    m_skinHeight = aliasHeader.skinheight;
+    m_numSkins = aliasHeader.numskins;
+    m_numTris = aliasHeader.numtris;
+    m_numFrames = aliasHeader.numframes;
+    m_numVerts = aliasHeader.numverts;
+
+    int64 skinSize = (int64)aliasHeader.skinwidth * aliasHeader.skinheight; // pre calculate total byte size of 1 skin
+
+    // pre allocate storage for our mesh data
+    m_texcoords.SetNum(aliasHeader.numverts);
+    m_triangles.SetNum(aliasHeader.numtris);
+
+    // Predefine position of all our data types in the mdl file
+    // No table exist for this so it must be calculated this way
+    // Skin groups have a variable size, everything after the skins is placed once they are read
+    int64 SKIN_POS = sizeof(AliasHeader);
+
+    // SKIN
+
+    m_skins.SetNum(aliasHeader.numskins);
+
+    for (int i = 0; i < aliasHeader.numskins; i++)
+    {
+        AliasTexture& skin = m_skins[i];
+
+        if (!Fits(SKIN_POS, sizeof(int)))
+        {
+            return;
+        }
+
+        SKIN_POS += QuakeCommon::ReadData<int>(buf, SKIN_POS, skin.type);
+
+        if (skin.type == 0)
+        {
+            // STATIC SKIN
+            skin.numframes = 1;
+        }
+        else
+        {
+            // SKIN GROUP
+            if (!Fits(SKIN_POS, sizeof(int)))
+            {
+                return;
+            }
+
+            SKIN_POS += QuakeCommon::ReadData<int>(buf, SKIN_POS, skin.numframes);
+
+            if (skin.numframes <= 0 || !Fits(SKIN_POS, sizeof(float) * (int64)skin.numframes))
+            {
+                return;
+            }
+
+            skin.intervals.Append(reinterpret_cast<const float*>(buf + SKIN_POS), skin.numframes);
+            SKIN_POS += sizeof(float) * skin.numframes;
+        }
+
+        if (!Fits(SKIN_POS, skinSize * skin.numframes))
+        {
+            return;
+        }
+
+        skin.data.Append(buf + SKIN_POS, skinSize * skin.numframes);
+        SKIN_POS += skinSize * skin.numframes;
+    }
+
+    int64 TEXTURE_VERTS_POS = SKIN_POS;
+    int64 TRIANGLES_POS = TEXTURE_VERTS_POS + (sizeof(AliasTexcoord) * aliasHeader.numverts);
+    int64 FRAMES_POS = TRIANGLES_POS + (sizeof(AliasTriangle) * aliasHeader.numtris);
+
+    if (!Fits(TEXTURE_VERTS_POS, FRAMES_POS - TEXTURE_VERTS_POS))
+    {
+        return;
+    }
+
+    // TEXTURE COORDINATES
+    for (int i = 0; i < aliasHeader.numverts; i++)
+    {
+        TEXTURE_VERTS_POS += QuakeCommon::ReadData<AliasTexcoord>(buf, TEXTURE_VERTS_POS, m_texcoords[i]);
+    }
+
+    // TRIANGLES
+    for (int i = 0; i < aliasHeader.numtris; i++)
+    {
+        TRIANGLES_POS += QuakeCommon::ReadData<AliasTriangle>(buf, TRIANGLES_POS, m_triangles[i]);
+
+        for (int corner : m_triangles[i].indices)
+        {
+            if (corner < 0 || corner >= aliasHeader.numverts)
+            {
+                return;
+            }
+        }
+    }
+
+    // FRAMES
+
+    // Count the poses first so they all fit in one preallocated buffer
+    // The size check of every frame happens here, the read pass below trusts it
+    int64 poseSize = sizeof(AliasPoint) * aliasHeader.numverts;
+    int64 framePos = FRAMES_POS;
+
+    for (int i = 0; i < aliasHeader.numframes; i++)
+    {
+        if (!Fits(framePos, sizeof(int)))
+        {
+            return;
+        }
+
+        int frametype;
+        framePos += QuakeCommon::ReadData<int>(buf, framePos, frametype);
+
+        if (frametype == 0) // ALIAS_SINGLE_FRAME
+        {
+            framePos += (sizeof(AliasPoint) * 2) + sizeof(AliasFrameName) + poseSize;
+            m_numPoses++;
+        }
+        else // ALIAS_FRAME_GROUP
+        {
+            if (!Fits(framePos, sizeof(AliasGroup)))
+            {
+                return;
+            }
+
+            AliasGroup group;
+            framePos += QuakeCommon::ReadData<AliasGroup>(buf, framePos, group);
+
+            if (group.numframes <= 0)
+            {
+                return;
+            }
+
+            framePos += (sizeof(float) + (sizeof(AliasPoint) * 2) + sizeof(AliasFrameName) + poseSize) * group.numframes;
+            m_numPoses += group.numframes;
+        }
+
+        if (!Fits(0, framePos))
+        {
+            return;
+        }
+    }
+
+    m_poseData.SetNumUninitialized(m_numPoses * m_numVerts * 4);
+
+    uint32 numPoses = 0;
+    uint32 clampedNormals = 0;
+
+    for (int i = 0; i < aliasHeader.numframes; i++)
+    {
+        int frametype;
+        FRAMES_POS += QuakeCommon::ReadData<int>(buf, FRAMES_POS, frametype);
+
+        if (frametype == 0) // ALIAS_SINGLE_FRAME
+        {
+            AliasFrame frame;
+
+            frame.type = frametype;
+            frame.numposes = 1;
+            frame.firstpose = numPoses;
+            frame.interval = 0;
+
+            FRAMES_POS += QuakeCommon::ReadData<AliasPoint>(buf, FRAMES_POS, frame.bboxmin);
+            FRAMES_POS += QuakeCommon::ReadData<AliasPoint>(buf, FRAMES_POS, frame.bboxmax);
+
+            AliasFrameName framename;
+            FRAMES_POS += QuakeCommon::ReadData<AliasFrameName>(buf, FRAMES_POS, framename);
+            frame.name = framename.str;
+
+            clampedNormals += ReadPose(buf + FRAMES_POS, numPoses++);
+            FRAMES_POS += poseSize;
+
+            m_frames.Add(frame);
+        }
+        else // ALIAS_FRAME_GROUP
+        {
+            AliasFrame frame;
+
+            frame.type = frametype;
+            AliasGroup group;
+            FRAMES_POS += QuakeCommon::ReadData<AliasGroup>(buf, FRAMES_POS, group);
+
+            frame.firstpose = numPoses;
+            frame.numposes = group.numframes;
+            frame.bboxmin = group.bboxmin;
+            frame.bboxmax = group.bboxmax;
+
+            // only use first interval for the frame.
+            QuakeCommon::ReadData<float>(buf, FRAMES_POS, frame.interval);
+            FRAMES_POS += sizeof(float) * group.numframes;
+
+            for (int j = 0; j < group.numframes; j++)
+            {
+                // skip pose bounds
+                FRAMES_POS += sizeof(AliasPoint) * 2;
+
+                AliasFrameName framename;
+                FRAMES_POS += QuakeCommon::ReadData<AliasFrameName>(buf, FRAMES_POS, framename);
+
+                if (frame.name.IsEmpty())
+                {
+                    frame.name = framename.str;
+                }
+
+                clampedNormals += ReadPose(buf + FRAMES_POS, numPoses++);
+                FRAMES_POS += poseSize;
+            }
+
+            m_frames.Add(frame);
+        }
+    }
+
+    if (clampedNormals)
+    {
+        UE_LOG(LogQuakeImporter, Warning, TEXT("%s: %u light normal indices past the %d Quake normals, clamped to the last one."), *m_name, clampedNormals, NUM_ALIAS_NORMALS);
+    }
+
+    m_valid = true;
+}
+
+uint32 Alias::ReadPose(const uint8* in, uint32 pose)
+{
+    uint8* positions = m_poseData.GetData() + (pose * m_numVerts * 3);
+    uint8* normals = m_poseData.GetData() + (m_numPoses * m_numVerts * 3) + (pose * m_numVerts);
+    uint32 clamped = 0;
+
+    // The file interleaves xyz and normal index, split them in a single pass.
+    // Normal indices are made valid here once, GetNormal and DecodeNormals rely on it.
+    for (uint32 i = 0; i < m_numVerts; i++)
+    {
+        positions[0] = in[0];
+        positions[1] = in[1];
+        positions[2] = in[2];
+
+        if (in[3] < NUM_ALIAS_NORMALS)
+        {
+            normals[i] = in[3];
+        }
+        else
+        {
+            normals[i] = NUM_ALIAS_NORMALS - 1;
+            clamped++;
+        }
+
+        positions += 3;
+        in += sizeof(AliasPoint);
+    }
+
+    return clamped;
+}
+
+AliasPoseView Alias::GetPose(uint32 index) const
+{
+    check(index < m_numPoses);
+
+    AliasPoseView view;
+    view.positions = m_poseData.GetData() + (index * m_numVerts * 3);
+    view.normals = m_poseData.GetData() + (m_numPoses * m_numVerts * 3) + (index * m_numVerts);
+    view.numpoints = m_numVerts;
+    return view;
+}
+
+void Alias::BuildMeshStreams(AliasMeshStreams& out) const
+{
+    QUAKE_IMPORT_SCOPE("WeldMesh");
+
+    // Render vertex of each (vertex, side) pair
+    TArray<int32> remap;
+    remap.Init(INDEX_NONE, m_numVerts * 2);
+
+    out.vertices.Reset(m_numVerts);
+    out.backside.Reset(m_numVerts);
+    out.indices.SetNumUninitialized(m_numTris * 3);
+
+    for (uint32 i = 0; i < m_numTris; i++)
+    {
+        const AliasTriangle& triangle = m_triangles[i];
+
+        for (int j = 0; j < 3; j++)
+        {
+            int vertex = triangle.indices[j];
+            uint8 backside = (m_texcoords[vertex].onseam > 0 && !triangle.front) ? 1 : 0;
+
+            int32& renderVertex = remap[(vertex * 2) + backside];
+
+            if (renderVertex == INDEX_NONE)
+            {
+                renderVertex = out.vertices.Add(vertex);
+                out.backside.Add(backside);
+            }
+
+            out.indices[(i * 3) + j] = renderVertex;
+        }
+    }
+}
+
+const FVector3f Alias::UnpackVertex(AliasPoint in) const
+{
+    FVector3f out;
+
+    for (int i = 0; i < 3; i++)
+    {
+        out[i] = (m_scale[i] * in.position[i]) + m_origin[i];
+    }
+
+    return out;
+}
+
+const FVector3f Alias::GetNormal(uint32 index) const
+{
+    check(index < (uint32)NUM_ALIAS_NORMALS);
+
+    return FVector3f(
+        ALIAS_NORMALS[index][0],
+        ALIAS_NORMALS[index][1],
+        ALIAS_NORMALS[index][2]);
+}
+
+void Alias::DecodePositions(const AliasPoseView& pose, TArray<FVector3f>& outPositions, bool flipX) const
+{
+    const float sign = flipX ? -1.0f : 1.0f;
+    const VectorRegister4Float scale = MakeVectorRegisterFloat(sign * (float)m_scale.X, (float)m_scale.Y, (float)m_scale.Z, 0.0f);
+    const VectorRegister4Float origin = MakeVectorRegisterFloat(sign * (float)m_origin.X, (float)m_origin.Y, (float)m_origin.Z, 0.0f);
+
+    outPositions.SetNumUninitialized(pose.numpoints);
+    FVector3f* out = outPositions.GetData();
+    const uint8* in = pose.positions;
+
+    if (pose.numpoints == 0)
+    {
+        return;
+    }
+
+    // Loads 4 bytes for a 3 byte point, the extra byte is the next point and its lane is zeroed by the scale.
+    // The last point has no next one in the view, it is unpacked without the vector load.
+    const uint32 last = pose.numpoints - 1;
+
+    for (uint32 i = 0; i < last; i++)
+    {
+        const VectorRegister4Float packed = VectorLoadByte4(in);
+        VectorStoreFloat3(VectorMultiplyAdd(packed, scale, origin), &out[i].X);
+        in += 3;
+    }
+
+    out[last] = UnpackVertex(pose[last]);
+    out[last].X *= sign;
+}
+
+void Alias::DecodeNormals(const AliasPoseView& pose, TArray<FVector3f>& outNormals, bool flipX) const
+{
+    const float sign = flipX ? -1.0f : 1.0f;
+
+    outNormals.SetNumUninitialized(pose.numpoints);
+    FVector3f* out = outNormals.GetData();
+
+    for (uint32 i = 0; i < pose.numpoints; i++)
+    {
+        checkSlow(pose.normals[i] < NUM_ALIAS_NORMALS);
+        const float* normal = ALIAS_NORMALS[pose.normals[i]];
+        out[i] = FVector3f(sign * normal[0], normal[1], normal[2]);
+    }
+}
+
+void Alias::DecodePose(const AliasPoseView& pose, TArray<FVector3f>& outPositions, TArray<FVector3f>& outNormals, bool flipX) const
+{
+    DecodePositions(pose, outPositions, flipX);
+    DecodeNormals(pose, outNormals, flipX);
+}
+
+FBox3f Alias::GetPoseBounds(uint32 firstPose, uint32 numPoses, bool flipX) const
+{
+    // Bounds of the packed bytes first, one unpack per corner
+    AliasPoint packedMin = { { 255, 255, 255 }, 0 };
+    AliasPoint packedMax = { { 0, 0, 0 }, 0 };
+
+    for (uint32 i = firstPose; i < firstPose + numPoses && i < m_numPoses; i++)
+    {
+        const uint8* in = GetPose(i).positions;
+
+        for (uint32 j = 0; j < m_numVerts * 3; j++)
+        {
+            packedMin.position[j % 3] = FMath::Min(packedMin.position[j % 3], in[j]);
+            packedMax.position[j % 3] = FMath::Max(packedMax.position[j % 3], in[j]);
+        }
+    }
+
+    FBox3f box(ForceInit);
+
+    if (packedMin.position[0] > packedMax.position[0])
+    {
+        return box;
+    }
+
+    const float sign = flipX ? -1.0f : 1.0f;
+
+    for (const AliasPoint& corner : { packedMin, packedMax })
+    {
+        FVector3f position = UnpackVertex(corner);
+        position.X *= sign;
+        box += position;
+    }
 
-    return vector;
+    return box;
 }
@@ -12,10 +12,13 @@ Alias
 ============================================
 */
 
-// Raw Texture
+// Raw Texture. Skin groups store numframes images back to back.
 struct AliasTexture
 {
-    TArray<uint8> data;
+    int             type = 0; // 0 single, 1 group
+    int             numframes = 1;
+    TArray<float>   intervals; // group only
+    TArray<uint8>   data;
 };
 
 // Texture coordinates
@@ -33,6 +36,9 @@ struct AliasTriangle
     int indices[3];
 };
 
+// Size of the Quake anorms.h table. The parser clamps larger light normal indices to the last one.
+constexpr int NUM_ALIAS_NORMALS = 162;
+
 // Packed vertex position
 struct AliasPoint
 {
@@ -48,17 +54,28 @@ struct AliasGroup
     AliasPoint bboxmax;
 };
 
-// Animation pose
-struct AliasPose
+// Read-only view of one animation pose inside the model pose buffer
+struct AliasPoseView
 {
-    TArray<AliasPoint> points;
+    const uint8* positions; // packed xyz, 3 bytes per point
+    const uint8* normals;   // light normal index, 1 byte per point
+    uint32 numpoints;
 
-    AliasPose(int numpoints)
+    AliasPoint operator[](uint32 index) const
     {
-        points.SetNum(numpoints);
+        const uint8* position = positions + index * 3;
+        return { { position[0], position[1], position[2] }, normals[index] };
     }
 };
 
+// Deduplicated render mesh, one vertex per unique (vertex, onseam side) pair
+struct AliasMeshStreams
+{
+    TArray<uint32>  vertices;   // source vertex of each render vertex
+    TArray<uint8>   backside;   // 1 if the render vertex takes the onseam back side uv
+    TArray<uint32>  indices;    // 3 render vertices per triangle, in mdl winding
+};
+
 // Animation frame description
 struct AliasFrame
 {
@@ -75,7 +92,10 @@ struct AliasFrame
 class Alias
 {
 public:
-    Alias(const FString name, const uint8*& buf);
+    Alias(const FString name, const uint8*& buf, int64 size);
+
+    // False when the file is not an IDPO version 6 model or its data runs past the buffer
+    bool IsValid() const { return m_valid; }
 
     // Header
     FString     m_name;
@@ -94,11 +114,25 @@ public:
     TArray<AliasTexcoord>   m_texcoords;
     TArray<AliasTriangle>   m_triangles;
     TArray<AliasFrame>      m_frames;
-    TArray<AliasPose>       m_poses;
+
+    // Animation poses
+    uint32 GetNumPoses() const { return m_numPoses; }
+    AliasPoseView GetPose(uint32 index) const;
 
     const FVector3f UnpackVertex(AliasPoint in) const;
     const FVector3f GetNormal(uint32 index) const;
 
+    // Weld triangle corners into unique render vertices
+    void BuildMeshStreams(AliasMeshStreams& out) const;
+
+    // Batch decode a whole pose. flipX mirrors the output on the X axis for Unreal space.
+    void DecodePositions(const AliasPoseView& pose, TArray<FVector3f>& outPositions, bool flipX = false) const;
+    void DecodeNormals(const AliasPoseView& pose, TArray<FVector3f>& outNormals, bool flipX = false) const;
+    void DecodePose(const AliasPoseView& pose, TArray<FVector3f>& outPositions, TArray<FVector3f>& outNormals, bool flipX = false) const;
+
+    // Box around every point of numPoses poses from firstPose, measured on the poses instead of trusting the mdl boxes
+    FBox3f GetPoseBounds(uint32 firstPose, uint32 numPoses, bool flipX = false) const;
+
 // Needed at import time only. No need to keep this in the global namespace
 private:
 
@@ -125,6 +159,14 @@ private:
         char str[16];
     };
 
-    //
+    // Split one pose from the file into the position and normal planes.
+    // Returns how many light normal indices were past the table and got clamped.
+    uint32 ReadPose(const uint8* in, uint32 pose);
+
+    // Every pose in one allocation. Pose-major packed positions (numPoses * numVerts * 3)
+    // followed by the light normal index plane (numPoses * numVerts).
+    TArray<uint8>   m_poseData;
+    uint32          m_numPoses;
+    bool            m_valid;
 
 };
\ No newline at end of file
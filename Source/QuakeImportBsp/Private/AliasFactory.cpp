@@ -7,22 +7,33 @@
 #include "AssetToolsModule.h"
 #include "CoreMinimal.h"
 #include "EditorClassUtils.h"
+#include "MeshDescription.h"
 #include "PackageTools.h"
-#include "RawMesh.h"
+#include "StaticMeshAttributes.h"
 #include "Engine/DataTable.h"
 #include "Engine/StaticMesh.h"
 #include "Engine/Texture2D.h"
+#include "Engine/Texture2DArray.h"
 #include "Materials/Material.h"
-#include "Math/Float16Color.h"
 #include "Misc/FileHelper.h"
 #include "UObject/Package.h"
 #include "RHI.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
 
 // Quake Import
 #include "QuakeCommon.h"
+#include "BspFactory.h"
 #include "BspUtilities.h"
 #include "AliasFrameDesc.h"
+#include "AliasSkinDesc.h"
 #include "Alias.h"
+#include "AliasPoseReduction.h"
+#include "AliasVat.h"
+#include "ImportCache.h"
+#include "ImportSession.h"
+#include "ImportStats.h"
+#include "QuakeImportSettings.h"
 
 #define LOCTEXT_NAMESPACE "AliasFactory"
 
@@ -35,174 +46,301 @@ UAliasFactory::UAliasFactory(const FObjectInitializer& ObjectInitializer):
     bEditorImport = true;
 }
 
-void GenerateAnimations(const FString& name, const Alias& model, UPackage* package)
+UTexture2D* CreateVatTexture(const FString& name, int width, int height, EPixelFormat pixelformat, ETextureSourceFormat sourceformat, TextureCompressionSettings compression, const void* data, UPackage* package)
 {
-    // Export Animation
-
-    FString animationFilename = name + "_animation";
-
-    int width = model.m_numVerts;
-    int height = model.m_poses.Num();
-
-    TArray<FFloat16Color> animationData; // animation data
-
-    for (int i = 0; i < height; i++)
-    {
-        for (uint32 j = 0; j < model.m_numVerts; j++)
-        {
-            FVector3f position = model.UnpackVertex(model.m_poses[i].points[j]);
-            position -= model.UnpackVertex(model.m_poses[0].points[j]);
-
-            FFloat16Color color;
-
-            color.R = FFloat16(-position.X); // flip x axis
-            color.G = FFloat16(position.Y);
-            color.B = FFloat16(position.Z);
-            color.A = 255;
-            animationData.Add(color);
-		}
-    }
+    QUAKE_IMPORT_SCOPE("CreateTexture");
 
     // Create Texture
-    UTexture2D* animationTexture = NewObject<UTexture2D>(package, FName(*animationFilename), RF_Public | RF_Standalone);
-    animationTexture->AddToRoot();
-
-    EPixelFormat pixelformat = PF_A32B32G32R32F;
-
-    animationTexture->PlatformData = new FTexturePlatformData();
-    animationTexture->PlatformData->SizeX = width;
-    animationTexture->PlatformData->SizeY = height;
-    animationTexture->PlatformData->PixelFormat = pixelformat; // PF_B8G8R8A8
-    //animationTexture->PlatformData->NumSlices = 1;
-    animationTexture->MipGenSettings = TMGS_NoMipmaps;
-    animationTexture->CompressionSettings = TextureCompressionSettings::TC_HDR;
-    animationTexture->LODGroup = TextureGroup::TEXTUREGROUP_UI;
-    animationTexture->Filter = TextureFilter::TF_Nearest;
+    UTexture2D* texture = NewObject<UTexture2D>(package, FName(*name), RF_Public | RF_Standalone);
+    QuakeCommon::ImportSession::Root(*texture);
+
+    texture->PlatformData = new FTexturePlatformData();
+    texture->PlatformData->SizeX = width;
+    texture->PlatformData->SizeY = height;
+    texture->PlatformData->PixelFormat = pixelformat;
+    texture->MipGenSettings = TMGS_NoMipmaps;
+    texture->CompressionSettings = compression;
+    texture->LODGroup = TextureGroup::TEXTUREGROUP_UI;
+    texture->Filter = TextureFilter::TF_Nearest;
+    texture->SRGB = false;
 
     // Create first mip
-    FTexture2DMipMap* texmip = new(animationTexture->PlatformData->Mips) FTexture2DMipMap();
+    FTexture2DMipMap* texmip = new(texture->PlatformData->Mips) FTexture2DMipMap();
 
     int32 nBlocksX = width / GPixelFormats[pixelformat].BlockSizeX;
     int32 nBlocksY = height / GPixelFormats[pixelformat].BlockSizeY;
+    int32 dataSize = nBlocksX * nBlocksY * GPixelFormats[pixelformat].BlockBytes;
     texmip->SizeX = width;
     texmip->SizeY = height;
     texmip->BulkData.Lock(LOCK_READ_WRITE);
-    uint8* animationTextureData = (uint8*)texmip->BulkData.Realloc(nBlocksX * nBlocksY * GPixelFormats[pixelformat].BlockBytes);
-    FMemory::Memcpy(animationTextureData, animationData.GetData(), nBlocksX * nBlocksY * GPixelFormats[pixelformat].BlockBytes);
+    uint8* textureData = (uint8*)texmip->BulkData.Realloc(dataSize);
+    FMemory::Memcpy(textureData, data, dataSize);
     texmip->BulkData.Unlock();
-    animationTexture->Source.Init(width, height, 1, 1, TSF_RGBA16F, animationTextureData);
+    texture->Source.Init(width, height, 1, 1, sourceformat, textureData);
 
-    FAssetRegistryModule::AssetCreated(animationTexture);
-    animationTexture->UpdateResource();
+    FAssetRegistryModule::AssetCreated(texture);
+    texture->UpdateResource();
 
     package->MarkPackageDirty();
+
+    return texture;
+}
+
+// Everything converted from the mdl that the assets are created from. Stored in the import cache.
+struct AliasImportProducts
+{
+    AliasPoseRemap      remap;
+    AliasMeshStreams    streams;
+    TArray<uint8>       animationData;  // _animation texels in the VatEncoding format
+    TArray<uint8>       normalData;     // _normal texels, BGRA8. Empty with PackedNormalIndex.
+};
+
+FArchive& operator<<(FArchive& ar, AliasPoseRef& ref)
+{
+    return ar << ref.row << ref.blendRow << ref.blend;
 }
 
-void GenerateAnimationNormals(const FString& name, const Alias& model, UPackage* package)
+FArchive& operator<<(FArchive& ar, AliasImportProducts& products)
+{
+    ar << products.remap.rows << products.remap.poses;
+    ar << products.streams.vertices << products.streams.backside << products.streams.indices;
+    ar << products.animationData << products.normalData;
+    return ar;
+}
+
+UTexture2D* GenerateAnimations(const FString& name, const VatLayout& layout, const TArray<uint8>& animationData, UPackage* package)
+{
+    // Export Animation
+
+    FString animationFilename = name + "_animation";
+
+    if (IsQuantizedVat())
+    {
+        return CreateVatTexture(animationFilename, layout.width, layout.height, PF_B8G8R8A8, TSF_BGRA8, TC_VectorDisplacementmap, animationData.GetData(), package);
+    }
+
+    return CreateVatTexture(animationFilename, layout.width, layout.height, PF_FloatRGBA, TSF_RGBA16F, TC_HDR, animationData.GetData(), package);
+}
+
+// The per-vertex normal texture, or the normal table when the normal index is packed in the animation alpha
+UTexture2D* GenerateAnimationNormals(const FString& name, const Alias& model, const VatLayout& layout, const TArray<uint8>& normalData, UPackage* package)
 {
     // Export normals
 
+    if (GetDefault<UQuakeImportSettings>()->VatEncoding == EAliasVatEncoding::PackedNormalIndex)
+    {
+        // Normal of every light normal index. The parser clamps indices past the Quake normals,
+        // the entries after them repeat the last normal so any byte value still samples a unit vector.
+        constexpr int LUT_SIZE = 256;
+
+        TArray<uint8> indices;
+        indices.SetNumUninitialized(LUT_SIZE);
+
+        for (int i = 0; i < LUT_SIZE; i++)
+        {
+            indices[i] = (uint8)FMath::Min(i, NUM_ALIAS_NORMALS - 1);
+        }
+
+        TArray<FVector3f> normals;
+        model.DecodeNormals({ nullptr, indices.GetData(), LUT_SIZE }, normals, true); // flip x axis
+
+        TArray<FColor> lut;
+        lut.SetNumUninitialized(LUT_SIZE);
+
+        for (int i = 0; i < LUT_SIZE; i++)
+        {
+            lut[i] = EncodeVatNormal(normals[i]);
+        }
+
+        // Uncompressed, block compression would blend neighbouring entries
+        return CreateVatTexture(name + "_normal_lut", LUT_SIZE, 1, PF_B8G8R8A8, TSF_BGRA8, TC_VectorDisplacementmap, lut.GetData(), package);
+    }
+
     FString normalFilename = name + "_normal";
 
-    int width = model.m_numVerts;
-    int height = model.m_poses.Num();
+    // Not TC_Normalmap, its two channel compression rebuilds z and loses the sign of normals facing down
+    return CreateVatTexture(normalFilename, layout.width, layout.height, PF_B8G8R8A8, TSF_BGRA8, TC_VectorDisplacementmap, normalData.GetData(), package);
+}
+
+// Fetch the converted products from the import cache or build them. False when the VAT can't fit a texture.
+bool GetAliasImportProducts(const Alias& model, const uint8* buffer, const uint8* bufferEnd, AliasImportProducts& out, VatLayout& outLayout)
+{
+    const UQuakeImportSettings* settings = GetDefault<UQuakeImportSettings>();
 
-    TArray<uint8> normalData;
+    FString settingsKey = FString::Printf(TEXT("%d %d %d %g"), (int)settings->VatEncoding, (int)settings->VatLayout, settings->bDeduplicatePoses ? 1 : 0, settings->PoseReductionTolerance);
+    FString cacheKey = QuakeCommon::MakeCacheKey(TEXT("alias"), buffer, bufferEnd - buffer, settingsKey);
 
-    for (int i = 0; i < height; i++)
+    TArray<uint8> cached;
+
+    if (QuakeCommon::LoadCachedData(cacheKey, cached))
     {
-        for (uint32 j = 0; j < model.m_numVerts; j++)
+        FMemoryReader reader(cached);
+        reader << out;
+
+        if (!reader.IsError())
         {
-            FVector3f normal = model.GetNormal(model.m_poses[i].points[j].lightnormalindex);
+            UE_LOG(LogQuakeImporter, Log, TEXT("%s: using cached VAT and mesh streams."), *model.m_name);
+            return ComputeVatLayout(model, out.remap, outLayout);
+        }
 
-            normal.X *= -1;
+        out = AliasImportProducts();
+    }
 
-            normalData.Add(((normal.Z + 1) * 0.5f) * 255.0f);
-            normalData.Add(((normal.Y + 1) * 0.5f) * 255.0f);
-            normalData.Add(((normal.X + 1) * 0.5f) * 255.0f);
-            normalData.Add(255);
-        }
+    // Pick the poses written to the VAT
+    ReduceAliasPoses(model, settings->bDeduplicatePoses, settings->PoseReductionTolerance, out.remap);
+
+    UE_LOG(LogQuakeImporter, Log, TEXT("%s: %d of %d poses written to the VAT."), *model.m_name, out.remap.rows.Num(), (int32)model.GetNumPoses());
+
+    if (!ComputeVatLayout(model, out.remap, outLayout))
+    {
+        return false;
     }
 
-    // Create Texture
-    UTexture2D* normalTexture = NewObject<UTexture2D>(package, FName(*normalFilename), RF_Public | RF_Standalone);
-    normalTexture->AddToRoot();
+    // Unique (vertex, onseam side) pairs and their index buffer
+    model.BuildMeshStreams(out.streams);
+    BuildAnimationData(model, out.remap, outLayout, out.animationData);
 
-    EPixelFormat pixelformat = PF_B8G8R8A8;
+    if (settings->VatEncoding != EAliasVatEncoding::PackedNormalIndex)
+    {
+        BuildAnimationNormalData(model, out.remap, outLayout, out.normalData);
+    }
 
-    normalTexture->PlatformData = new FTexturePlatformData();
-    normalTexture->PlatformData->SizeX = width;
-    normalTexture->PlatformData->SizeY = height;
-    normalTexture->PlatformData->PixelFormat = pixelformat; // PF_B8G8R8A8
-    //normalTexture->PlatformData->NumSlices = 1;
-    normalTexture->MipGenSettings = TMGS_NoMipmaps;
-    normalTexture->CompressionSettings = TextureCompressionSettings::TC_Normalmap;
-    normalTexture->LODGroup = TextureGroup::TEXTUREGROUP_UI;
-    normalTexture->Filter = TextureFilter::TF_Nearest;
+    TArray<uint8> data;
+    FMemoryWriter writer(data);
+    writer << out;
+    QuakeCommon::StoreCachedData(cacheKey, data);
 
-    // Create first mip
-    FTexture2DMipMap* texmip = new(normalTexture->PlatformData->Mips) FTexture2DMipMap();
+    return true;
+}
 
-    int32 nBlocksX = width / GPixelFormats[pixelformat].BlockSizeX;
-    int32 nBlocksY = height / GPixelFormats[pixelformat].BlockSizeY;
-    texmip->SizeX = width;
-    texmip->SizeY = height;
-    texmip->BulkData.Lock(LOCK_READ_WRITE);
-    uint8* normalTextureData = (uint8*)texmip->BulkData.Realloc(nBlocksX * nBlocksY * GPixelFormats[pixelformat].BlockBytes);
-    FMemory::Memcpy(normalTextureData, normalData.GetData(), nBlocksX * nBlocksY * GPixelFormats[pixelformat].BlockBytes);
-    texmip->BulkData.Unlock();
-    normalTexture->Source.Init(width, height, 1, 1, TSF_BGRA8, normalTextureData);
+void SetVatMaterialParameters(UMaterialInterface& material, const Alias& model, const VatLayout& layout, UTexture2D* animation, UTexture2D* normal)
+{
+    // Sampled by the vertex animation graph of the alias masters
+    if (animation)
+    {
+        QuakeCommon::SetMaterialTextureParameter(material, TEXT("VatAnimation"), *animation);
+    }
 
-    FAssetRegistryModule::AssetCreated(normalTexture);
-    normalTexture->UpdateResource();
+    if (normal)
+    {
+        QuakeCommon::SetMaterialTextureParameter(material, TEXT("VatNormal"), *normal);
+    }
 
-    package->MarkPackageDirty();
+    // VatNormal is the _normal_lut table addressed by the animation alpha
+    const bool packedNormals = GetDefault<UQuakeImportSettings>()->VatEncoding == EAliasVatEncoding::PackedNormalIndex;
+    QuakeCommon::SetMaterialScalarParameter(material, TEXT("VatPackedNormals"), packedNormals ? 1.0f : 0.0f);
+
+    // Quantized8 texels are sampled as 0-1, position = texel * VatScale + VatOrigin.
+    // X is negated to match the axis flip applied to the mesh. W = 1 marks absolute
+    // positions, the graph subtracts the mesh vertex to get the offset.
+    // Float16Delta texels are offsets from the mesh vertex, already flipped.
+    const bool quantized = IsQuantizedVat();
+    FLinearColor scale = quantized ? FLinearColor(-model.m_scale.X * 255.0f, model.m_scale.Y * 255.0f, model.m_scale.Z * 255.0f, 1.0f) : FLinearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    FLinearColor origin = quantized ? FLinearColor(-model.m_origin.X, model.m_origin.Y, model.m_origin.Z, 0.0f) : FLinearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // One batch, a standalone material recompiles once
+    const TPair<FName, FLinearColor> parameters[] = {
+        // Texture width, height, rows per pose and vertex count to address the VAT from UV channel 1
+        { TEXT("VatLayout"), FLinearColor(layout.width, layout.height, layout.rowsPerPose, model.m_numVerts) },
+
+        // Texels per pose row and poses per band of rows, pose n starts at column n % poseColumns of band n / poseColumns
+        { TEXT("VatPoseTiling"), FLinearColor(layout.poseWidth, layout.poseColumns, 0.0f, 0.0f) },
+
+        { TEXT("VatScale"), scale },
+        { TEXT("VatOrigin"), origin },
+    };
+
+    QuakeCommon::SetMaterialVectorParameters(material, parameters);
 }
 
-UStaticMesh* BuildStaticMesh(const FName& name, const Alias& model, UPackage* package)
+// Create the skin material, or find the one of a previous import when the skin texture already
+// exists, and point it at the VAT of this import. Reimports change the layout and scale.
+void SetupAliasMaterial(const FString& materialName, UTexture* texture, QuakeCommon::EQuakeMaterial surface, const Alias& model, const VatLayout& layout, UTexture2D* animation, UTexture2D* normal, UPackage& package)
 {
-    UStaticMesh* staticmesh = NewObject<UStaticMesh>(package, name, RF_Public | RF_Standalone);
-    staticmesh->AddToRoot();
+    UMaterialInterface* material = texture
+        ? QuakeCommon::CreateUMaterial(materialName, package, *texture, surface)
+        : (UMaterialInterface*)QuakeCommon::CheckIfAssetExist<UMaterialInterface>(materialName, package);
+
+    if (!material)
+    {
+        UE_LOG(LogQuakeImporter, Warning, TEXT("%s: no material, the VAT parameters are not set."), *materialName);
+        return;
+    }
 
-    FRawMesh* rmesh = new FRawMesh();
+    SetVatMaterialParameters(*material, model, layout, animation, normal);
+}
+
+UStaticMesh* BuildStaticMesh(const FName& name, const Alias& model, const AliasMeshStreams& streams, const VatLayout& layout, const FBox3f& animationBounds, UPackage* package)
+{
+    QUAKE_IMPORT_SCOPE("BuildStaticMesh");
+
+    UStaticMesh* staticmesh = NewObject<UStaticMesh>(package, name, RF_Public | RF_Standalone);
+    QuakeCommon::ImportSession::Root(*staticmesh);
 
     // Vertices
     // Grab first frame for positions
     // Animated models will use uproceduralmesh for the animations
+    TArray<FVector3f> positions;
+    TArray<FVector3f> normals;
+    model.DecodePose(model.GetPose(0), positions, normals, true); // flip x axis
+
+    FMeshDescription meshDescription;
+    FStaticMeshAttributes attributes(meshDescription);
+    attributes.Register();
+
+    TVertexAttributesRef<FVector3f> vertexPositions = attributes.GetVertexPositions();
+    TVertexInstanceAttributesRef<FVector3f> vertexNormals = attributes.GetVertexInstanceNormals();
+    TVertexInstanceAttributesRef<FVector4f> vertexColors = attributes.GetVertexInstanceColors();
+    TVertexInstanceAttributesRef<FVector2f> vertexUVs = attributes.GetVertexInstanceUVs();
+    vertexUVs.SetNumChannels(2);
+
+    meshDescription.ReserveNewVertices(model.m_numVerts);
+
     for (uint32 i = 0; i < model.m_numVerts; i++)
     {
-        FVector3f vec = model.UnpackVertex(model.m_poses[0].points[i]);
-        vec.X *= -1; // flip x axis
-        rmesh->VertexPositions.Add(vec);
+        vertexPositions[meshDescription.CreateVertex()] = positions[i];
     }
 
-    // Append all triangles
+    // One vertex instance per render vertex. UE keeps them as is, no float compares to weld.
+    meshDescription.ReserveNewVertexInstances(streams.vertices.Num());
 
-    for (uint32 i = 0; i < model.m_numTris; i++)
+    for (int32 i = 0; i < streams.vertices.Num(); i++)
     {
-        for (uint32 j = 3; j-- > 0;) // flip face
+        int index = streams.vertices[i];
+
+        // Unpack UV
+        const AliasTexcoord& st = model.m_texcoords[index];
+        FVector2f texcoord((float)st.s / model.m_skinWidth, (float)st.t / model.m_skinHeight);
+        if (streams.backside[i])
         {
-            // Unpack UV
-            const AliasTexcoord* st = &model.m_texcoords[model.m_triangles[i].indices[j]];
-            FVector2f texcoord((float)st->s / model.m_skinWidth, (float)st->t / model.m_skinHeight);
-            if (st->onseam > 0 && !model.m_triangles[i].front)
-            {
-                texcoord.X += 0.5f; // offset by 0.5 for uv on the back side of our model
-            }
+            texcoord.X += 0.5f; // offset by 0.5 for uv on the back side of our model
+        }
 
-            // Set vertex
-            int index = model.m_triangles[i].indices[j];
-            FVector3f normal = model.GetNormal(model.m_poses[0].points[index].lightnormalindex);
-            normal.X *= -1;
+        const FVertexInstanceID instance = meshDescription.CreateVertexInstance(FVertexID(index));
+        vertexNormals[instance] = normals[index];
+        vertexColors[instance] = FVector4f(0.0f, 0.0f, 0.0f, 0.0f);
+        vertexUVs.Set(instance, 0, texcoord);
+        vertexUVs.Set(instance, 1, layout.VertexUV(index)); // this channel is for the vertex animation
+    }
 
-            rmesh->WedgeIndices.Add(index);
-            rmesh->WedgeColors.Add(FColor(0));
-            rmesh->WedgeTangentZ.Add(normal); // normal
-            rmesh->WedgeTexCoords[0].Add(texcoord);
-            rmesh->WedgeTexCoords[1].Add(FVector2f(((float)index + 0.5f) / model.m_numVerts, 0.5f)); // this channel is for the vertex animation
-        }
-        rmesh->FaceMaterialIndices.Add(0);
-        rmesh->FaceSmoothingMasks.Add(0); // TODO dont know how that work yet
+    // Append all triangles
+
+    const FPolygonGroupID polygonGroup = meshDescription.CreatePolygonGroup();
+    attributes.GetPolygonGroupMaterialSlotNames()[polygonGroup] = FName(*(name.ToString() + "_material_0"));
+
+    meshDescription.ReserveNewTriangles(model.m_numTris);
+    meshDescription.ReserveNewPolygons(model.m_numTris);
+
+    for (uint32 i = 0; i < model.m_numTris; i++)
+    {
+        // flip face
+        const FVertexInstanceID corners[3] = {
+            FVertexInstanceID(streams.indices[(i * 3) + 2]),
+            FVertexInstanceID(streams.indices[(i * 3) + 1]),
+            FVertexInstanceID(streams.indices[(i * 3) + 0])
+        };
+
+        meshDescription.CreateTriangle(polygonGroup, MakeArrayView(corners));
     }
 
     // build staticmesh
@@ -214,7 +352,17 @@ UStaticMesh* BuildStaticMesh(const FName& name, const Alias& model, UPackage* pa
     srcModel->BuildSettings.bUseFullPrecisionUVs = true;
     srcModel->BuildSettings.DistanceFieldResolutionScale = 0.0f;
     srcModel->BuildSettings.bGenerateLightmapUVs = false;
-    srcModel->RawMeshBulkData->SaveRawMesh(*rmesh);
+
+    // The mesh is pose 0, the VAT moves it anywhere in the box of all the poses
+    if (animationBounds.IsValid)
+    {
+        FBox3f meshBounds = model.GetPoseBounds(0, 1, true);
+        staticmesh->SetPositiveBoundsExtension(FVector(FVector3f::Max(animationBounds.Max - meshBounds.Max, FVector3f::ZeroVector)));
+        staticmesh->SetNegativeBoundsExtension(FVector(FVector3f::Max(meshBounds.Min - animationBounds.Min, FVector3f::ZeroVector)));
+    }
+
+    staticmesh->CreateMeshDescription(0, MoveTemp(meshDescription));
+    staticmesh->CommitMeshDescription(0);
 
     staticmesh->ImportVersion = EImportStaticMeshVersion::LastVersion;
     staticmesh->CreateBodySetup();
@@ -224,84 +372,158 @@ UStaticMesh* BuildStaticMesh(const FName& name, const Alias& model, UPackage* pa
 
     package->MarkPackageDirty();
 
-    delete rmesh;
-
     return staticmesh;
 }
 
 UObject* UAliasFactory::FactoryCreateBinary(UClass* InClass, UObject* InParent, FName Name, EObjectFlags Flags, UObject* Context, const TCHAR* Type, const uint8*& Buffer, const uint8* BufferEnd, FFeedbackContext* Warn)
 {
-    Alias* alias = new Alias(Name.ToString(), Buffer);
+    QuakeCommon::ImportReport report(TEXT("Alias"), Name.ToString());
+    QuakeCommon::ImportSession session;
 
-    if (alias)
+    Alias* alias = &session.Own(MakeUnique<Alias>(Name.ToString(), Buffer, BufferEnd - Buffer));
+
+    if (!alias->IsValid())
     {
-        // Create Package
-        FString packageName = TEXT("/Game/Alias/") / Name.ToString();
-        UPackage* package = CreatePackage(nullptr, *packageName);
-        package->FullyLoad();
+        UE_LOG(LogQuakeImporter, Error, TEXT("Failed to import mdl file '%s'. Not an IDPO version 6 model or truncated."), *Name.ToString());
+        return nullptr;
+    }
 
-        UStaticMesh* staticMesh = BuildStaticMesh(Name, *alias, package);
+    // Create Package
+    FString packageName = TEXT("/Game/Alias/") / Name.ToString();
+    UPackage* package = CreatePackage(nullptr, *packageName);
+    package->FullyLoad();
 
-        if (staticMesh)
+    AliasImportProducts products;
+    VatLayout layout;
+
+    if (!GetAliasImportProducts(*alias, Buffer, BufferEnd, products, layout))
+    {
+        return nullptr;
+    }
+
+    const AliasPoseRemap& remap = products.remap;
+
+    TArray<FBox3f> frameBounds;
+    FBox3f animationBounds(ForceInit);
+
+    for (const AliasFrame& frame : alias->m_frames)
+    {
+        animationBounds += frameBounds.Add_GetRef(alias->GetPoseBounds(frame.firstpose, frame.numposes, true));
+    }
+
+    UStaticMesh* staticMesh = BuildStaticMesh(Name, *alias, products.streams, layout, animationBounds, package);
+
+    if (staticMesh)
+    {
+        // Animate
+        UTexture2D* animationTexture = GenerateAnimations(Name.ToString(), layout, products.animationData, package);
+
+        // Normal
+        UTexture2D* normalTexture = GenerateAnimationNormals(Name.ToString(), *alias, layout, products.normalData, package);
+
+        // Load Palette
+        TArray<QuakeCommon::QColor> quakePalette;
+
+        if (!QuakeCommon::LoadPalette(quakePalette))
+        {
+            // ERROR
+        }
+
+        bool hasSkinGroup = false;
+
+        for (const AliasTexture& skin : alias->m_skins)
+        {
+            hasSkinGroup |= skin.type != 0;
+        }
+
+        if (hasSkinGroup)
         {
-            // Load Palette
-            TArray<QuakeCommon::QColor> quakePalette;
+            // Every skin and group frame goes in one texture array with a single material
+            TArray<uint8> slices;
+            int numSlices = 0;
 
-            if (!QuakeCommon::LoadPalette(quakePalette))
+            FString skinDescName = Name.ToString() + "_skin_desc";
+            UDataTable* skinTable = NewObject<UDataTable>(package, FName(*skinDescName), RF_Public | RF_Standalone);
+            QuakeCommon::ImportSession::Root(*skinTable);
+            skinTable->RowStruct = FAliasSkinDesc::StaticStruct();
+
+            for (int i = 0; i < alias->m_skins.Num(); i++)
             {
-                // ERROR
+                const AliasTexture& skin = alias->m_skins[i];
+
+                FAliasSkinDesc row;
+                row.Type = skin.type;
+                row.FirstSlice = numSlices;
+                row.NumFrames = skin.numframes;
+                row.Intervals = skin.intervals;
+                skinTable->AddRow(FName(*FString::FromInt(i)), row);
+
+                slices.Append(skin.data);
+                numSlices += skin.numframes;
             }
 
+            FAssetRegistryModule::AssetCreated(skinTable);
+
+            FString skinName = Name.ToString() + "_skins";
+            FString materialName = Name.ToString() + "_material_0";
+            UTexture2DArray* texture = QuakeCommon::CreateUTexture2DArray(skinName, alias->m_skinWidth, alias->m_skinHeight, numSlices, slices, *package, quakePalette);
+
+            SetupAliasMaterial(materialName, texture, QuakeCommon::EQuakeMaterial::AliasArray, *alias, layout, animationTexture, normalTexture, *package);
+        }
+        else
+        {
             for (uint32 i = 0; i < alias->m_numSkins; i++)
             {
                 FString skinName = Name.ToString() + "_skin_" + FString::FromInt(i);
                 FString materialName = Name.ToString() + "_material_" + FString::FromInt(i);
                 UTexture2D* texture = QuakeCommon::CreateUTexture2D(skinName, alias->m_skinWidth, alias->m_skinHeight, alias->m_skins[i].data, *package, quakePalette);
-                QuakeCommon::CreateUMaterial(materialName, *package, *texture);
-            }
 
-            // if we have a skin lets assign it to the material index 0
-            FString skin0 = Name.ToString() + "_material_0";
-            if (UMaterialInterface* material = (UMaterialInterface*)QuakeCommon::CheckIfAssetExist<UMaterialInterface>(skin0, *package))
-            {
-                staticMesh->GetStaticMaterials().AddUnique(FStaticMaterial(material, FName(*skin0), FName(*skin0)));
+                SetupAliasMaterial(materialName, texture, QuakeCommon::EQuakeMaterial::Alias, *alias, layout, animationTexture, normalTexture, *package);
             }
-            
-            // 
-            FString descFileName = Name.ToString() + "_desc";
-            UDataTable* table = NewObject<UDataTable>(package, FName(*descFileName), RF_Public | RF_Standalone);
-            table->AddToRoot();
-            table->RowStruct = FAliasFrameDesc::StaticStruct();
+        }
 
-            FString datacsv;
+        // if we have a skin lets assign it to the material index 0
+        FString skin0 = Name.ToString() + "_material_0";
+        if (UMaterialInterface* material = (UMaterialInterface*)QuakeCommon::CheckIfAssetExist<UMaterialInterface>(skin0, *package))
+        {
+            staticMesh->GetStaticMaterials().AddUnique(FStaticMaterial(material, FName(*skin0), FName(*skin0)));
+        }
+        
+        // 
+        FString descFileName = Name.ToString() + "_desc";
+        UDataTable* table = NewObject<UDataTable>(package, FName(*descFileName), RF_Public | RF_Standalone);
+        QuakeCommon::ImportSession::Root(*table);
+        table->RowStruct = FAliasFrameDesc::StaticStruct();
 
-            datacsv.Append(" ,Name, Type, Start, NumPoses, Interval\n");
+        FString datacsv;
 
-            for (int i = 0; i < alias->m_frames.Num(); i++)
-            {
-                datacsv.Append(FString::FromInt(i) + ",");
-                datacsv.Append(alias->m_frames[i].name + ",");
-                datacsv.Append(FString::FromInt(alias->m_frames[i].type) + ",");
-                datacsv.Append(FString::FromInt(alias->m_frames[i].firstpose) + ",");
-                datacsv.Append(FString::FromInt(alias->m_frames[i].numposes) + ",");
-                datacsv.Append(FString::SanitizeFloat(alias->m_frames[i].interval));
-                datacsv.Append("\n");
-            }
+        datacsv.Append(" ,Name, Type, Start, NumPoses, Interval, BlendTarget, BlendAlpha, BoundsMin, BoundsMax\n");
 
-            table->CreateTableFromCSVString(datacsv);
-
-            // Animate
-            GenerateAnimations(Name.ToString(), *alias, package);
+        for (int i = 0; i < alias->m_frames.Num(); i++)
+        {
+            // Rows after pose reduction
+            const AliasPoseRef& pose = remap.poses[alias->m_frames[i].firstpose];
+
+            datacsv.Append(FString::FromInt(i) + ",");
+            datacsv.Append(alias->m_frames[i].name + ",");
+            datacsv.Append(FString::FromInt(alias->m_frames[i].type) + ",");
+            datacsv.Append(FString::FromInt(pose.row) + ",");
+            datacsv.Append(FString::FromInt(alias->m_frames[i].numposes) + ",");
+            datacsv.Append(FString::SanitizeFloat(alias->m_frames[i].interval) + ",");
+            datacsv.Append(FString::FromInt(pose.blendRow) + ",");
+            datacsv.Append(FString::SanitizeFloat(pose.blend) + ",");
+            datacsv.Append(FString::Printf(TEXT("\"(X=%f,Y=%f,Z=%f)\","), frameBounds[i].Min.X, frameBounds[i].Min.Y, frameBounds[i].Min.Z));
+            datacsv.Append(FString::Printf(TEXT("\"(X=%f,Y=%f,Z=%f)\""), frameBounds[i].Max.X, frameBounds[i].Max.Y, frameBounds[i].Max.Z));
+            datacsv.Append("\n");
+        }
 
-            // Normal
-            GenerateAnimationNormals(Name.ToString(), *alias, package);
+        table->CreateTableFromCSVString(datacsv);
 
-            // Save
-            QuakeCommon::SavePackage(*package);
+        // Save
+        QuakeCommon::SavePackage(*package);
 
-            // Extract textures
-            return staticMesh;
-        }
+        // Extract textures
+        return staticMesh;
     }
 
     return nullptr;
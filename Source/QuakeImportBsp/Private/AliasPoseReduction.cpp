@@ -0,0 +1,254 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AliasPoseReduction.h"
+#include "Alias.h"
+#include "ImportStats.h"
+
+namespace
+{
+    bool PosesIdentical(const AliasPoseView& a, const AliasPoseView& b)
+    {
+        return FMemory::Memcmp(a.positions, b.positions, a.numpoints * 3) == 0 &&
+            FMemory::Memcmp(a.normals, b.normals, a.numpoints) == 0;
+    }
+
+    uint32 HashPose(const AliasPoseView& pose)
+    {
+        uint32 hash = FCrc::MemCrc32(pose.positions, pose.numpoints * 3);
+        return FCrc::MemCrc32(pose.normals, pose.numpoints, hash);
+    }
+
+    uint32 HashGroup(const Alias& model, const AliasFrame& frame)
+    {
+        uint32 hash = frame.numposes;
+
+        for (int32 i = 0; i < frame.numposes; i++)
+        {
+            hash = HashCombine(hash, HashPose(model.GetPose(frame.firstpose + i)));
+        }
+
+        return hash;
+    }
+
+    bool GroupsIdentical(const Alias& model, const AliasFrame& a, const AliasFrame& b)
+    {
+        if (a.numposes != b.numposes)
+        {
+            return false;
+        }
+
+        for (int32 i = 0; i < a.numposes; i++)
+        {
+            if (!PosesIdentical(model.GetPose(a.firstpose + i), model.GetPose(b.firstpose + i)))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Largest distance between pose k and the blend of poses a and b
+    float BlendError(const TArray<FVector3f>& a, const TArray<FVector3f>& b, const TArray<FVector3f>& k, float alpha)
+    {
+        float error = 0.0f;
+
+        for (int32 i = 0; i < k.Num(); i++)
+        {
+            error = FMath::Max(error, FVector3f::DistSquared(FMath::Lerp(a[i], b[i], alpha), k[i]));
+        }
+
+        return FMath::Sqrt(error);
+    }
+}
+
+void ReduceAliasPoses(const Alias& model, bool deduplicate, float tolerance, AliasPoseRemap& out)
+{
+    QUAKE_IMPORT_SCOPE("ReducePoses");
+
+    const int32 numPoses = model.GetNumPoses();
+
+    // Source poses a pose is blended from/to. Equal when the pose is kept.
+    TArray<int32> blendFrom;
+    TArray<int32> blendTo;
+    TArray<float> blend;
+    TArray<bool> single;
+
+    blendFrom.SetNumUninitialized(numPoses);
+    blendTo.SetNumUninitialized(numPoses);
+    blend.SetNumZeroed(numPoses);
+    single.SetNumZeroed(numPoses);
+
+    for (int32 i = 0; i < numPoses; i++)
+    {
+        blendFrom[i] = i;
+        blendTo[i] = i;
+    }
+
+    for (const AliasFrame& frame : model.m_frames)
+    {
+        if (frame.type == 0)
+        {
+            single[frame.firstpose] = true;
+        }
+    }
+
+    // Keyframe reduction over each run of consecutive single frame poses
+    if (tolerance > 0.0f)
+    {
+        TArray<TArray<FVector3f>> decoded;
+        decoded.SetNum(numPoses);
+
+        auto Decoded = [&](int32 pose) -> const TArray<FVector3f>&
+        {
+            if (!decoded[pose].Num())
+            {
+                model.DecodePositions(model.GetPose(pose), decoded[pose]);
+            }
+
+            return decoded[pose];
+        };
+
+        int32 anchor = 0;
+
+        while (anchor < numPoses)
+        {
+            if (!single[anchor])
+            {
+                anchor++;
+                continue;
+            }
+
+            int32 end = anchor + 1;
+
+            if (end >= numPoses || !single[end])
+            {
+                anchor = end;
+                continue;
+            }
+
+            // Push the end key as far as every pose in between stays within tolerance
+
+            while (end + 1 < numPoses && single[end + 1])
+            {
+                int32 candidate = end + 1;
+                bool reconstructs = true;
+
+                for (int32 k = anchor + 1; k < candidate && reconstructs; k++)
+                {
+                    float alpha = (float)(k - anchor) / (candidate - anchor);
+                    reconstructs = BlendError(Decoded(anchor), Decoded(candidate), Decoded(k), alpha) <= tolerance;
+                }
+
+                if (!reconstructs)
+                {
+                    break;
+                }
+
+                end = candidate;
+            }
+
+            for (int32 k = anchor + 1; k < end; k++)
+            {
+                blendFrom[k] = anchor;
+                blendTo[k] = end;
+                blend[k] = (float)(k - anchor) / (end - anchor);
+            }
+
+            anchor = end;
+        }
+    }
+
+    // Frame groups repeating the whole pose sequence of an earlier group reuse its run of rows
+    TArray<int32> groupSource;
+    groupSource.Init(INDEX_NONE, numPoses);
+
+    if (deduplicate)
+    {
+        TMultiMap<uint32, const AliasFrame*> groups; // pose sequence hash -> first group with it
+
+        for (const AliasFrame& frame : model.m_frames)
+        {
+            if (frame.type == 0)
+            {
+                continue;
+            }
+
+            uint32 hash = HashGroup(model, frame);
+            TArray<const AliasFrame*> candidates;
+            groups.MultiFind(hash, candidates);
+
+            const AliasFrame* const* match = candidates.FindByPredicate([&](const AliasFrame* candidate)
+            {
+                return GroupsIdentical(model, frame, *candidate);
+            });
+
+            if (!match)
+            {
+                groups.Add(hash, &frame);
+                continue;
+            }
+
+            for (int32 i = 0; i < frame.numposes; i++)
+            {
+                groupSource[frame.firstpose + i] = (*match)->firstpose + i;
+            }
+        }
+    }
+
+    // Give every kept pose a row, sharing rows between bit exact duplicates
+    TArray<int32> rowOf;
+    rowOf.Init(INDEX_NONE, numPoses);
+
+    TMultiMap<uint32, int32> stored; // pose hash -> stored source pose
+    out.rows.Reset();
+
+    for (int32 i = 0; i < numPoses; i++)
+    {
+        if (blendFrom[i] != i)
+        {
+            continue; // dropped
+        }
+
+        if (groupSource[i] != INDEX_NONE)
+        {
+            rowOf[i] = rowOf[groupSource[i]]; // earlier pose, its row is set
+            continue;
+        }
+
+        const AliasPoseView pose = model.GetPose(i);
+        uint32 hash = HashPose(pose);
+
+        if (deduplicate && single[i])
+        {
+            TArray<int32> candidates;
+            stored.MultiFind(hash, candidates);
+
+            for (int32 candidate : candidates)
+            {
+                if (PosesIdentical(pose, model.GetPose(candidate)))
+                {
+                    rowOf[i] = rowOf[candidate];
+                    break;
+                }
+            }
+
+            if (rowOf[i] != INDEX_NONE)
+            {
+                continue;
+            }
+        }
+
+        rowOf[i] = out.rows.Add(i);
+        stored.Add(hash, i);
+    }
+
+    out.poses.SetNum(numPoses);
+
+    for (int32 i = 0; i < numPoses; i++)
+    {
+        out.poses[i].row = rowOf[blendFrom[i]];
+        out.poses[i].blendRow = rowOf[blendTo[i]];
+        out.poses[i].blend = blend[i];
+    }
+}
@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class Alias;
+
+/*
+============================================
+Alias pose reduction
+
+Import time pass deciding which poses are written to the VAT.
+Bit exact duplicates share a row. Single frame poses that a linear
+blend of their neighbours reproduces within tolerance are dropped.
+Frame group poses are always kept so each group stays a contiguous run of rows,
+a group with the same pose sequence as an earlier one shares its rows.
+Duplicate poses inside a group, and groups matching only part of another, keep their own rows.
+============================================
+*/
+
+// Where a source pose is found in the VAT rows
+struct AliasPoseRef
+{
+    int32 row;      // row holding the pose, or the row to blend from
+    int32 blendRow; // row to blend to, same as row when the pose is stored
+    float blend;    // blend factor from row to blendRow
+};
+
+struct AliasPoseRemap
+{
+    TArray<uint32>          rows;   // source pose written to each VAT row
+    TArray<AliasPoseRef>    poses;  // one per source pose
+};
+
+// tolerance is the maximum vertex error in model units allowed when dropping a pose. 0 keeps every distinct pose.
+void ReduceAliasPoses(const Alias& model, bool deduplicate, float tolerance, AliasPoseRemap& out);
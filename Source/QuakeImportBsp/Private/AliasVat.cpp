@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AliasVat.h"
+
+// Epic
+#include "Math/Float16Color.h"
+
+// Quake Import
+#include "Alias.h"
+#include "AliasPoseReduction.h"
+#include "BspFactory.h"
+#include "ImportStats.h"
+#include "QuakeImportSettings.h"
+
+bool IsQuantizedVat()
+{
+    EAliasVatEncoding encoding = GetDefault<UQuakeImportSettings>()->VatEncoding;
+    return encoding == EAliasVatEncoding::Quantized8 || encoding == EAliasVatEncoding::PackedNormalIndex;
+}
+
+bool ComputeVatLayout(const Alias& model, const AliasPoseRemap& remap, VatLayout& layout)
+{
+    int numVerts = model.m_numVerts;
+    int numPoses = remap.rows.Num();
+
+    layout.tiled = GetDefault<UQuakeImportSettings>()->VatLayout == EAliasVatLayout::Tiled;
+    layout.width = numVerts;
+    layout.height = numPoses;
+    layout.rowsPerPose = 1;
+    layout.poseWidth = numVerts;
+    layout.poseColumns = 1;
+
+    if (!layout.tiled && (numVerts > MAX_VAT_TEXTURE_SIZE || numPoses > MAX_VAT_TEXTURE_SIZE))
+    {
+        UE_LOG(LogQuakeImporter, Warning, TEXT("%s: %dx%d VAT exceeds the maximum texture size, using the tiled layout."), *model.m_name, numVerts, numPoses);
+        layout.tiled = true;
+    }
+
+    if (layout.tiled)
+    {
+        // Aim for a square texture. Poses wider than the side wrap over rows, spread evenly to minimize
+        // padding. Poses narrower than the side sit next to each other, many pose models stay square too.
+        int side = FMath::Min(FMath::CeilToInt(FMath::Sqrt((float)numVerts * numPoses)), MAX_VAT_TEXTURE_SIZE);
+        layout.rowsPerPose = FMath::DivideAndRoundUp(numVerts, FMath::Clamp(side, 1, numVerts));
+        layout.poseWidth = FMath::DivideAndRoundUp(numVerts, layout.rowsPerPose);
+        layout.poseColumns = FMath::Clamp(side / layout.poseWidth, 1, numPoses);
+        layout.width = layout.poseWidth * layout.poseColumns;
+        layout.height = layout.rowsPerPose * FMath::DivideAndRoundUp(numPoses, layout.poseColumns);
+    }
+
+    if (layout.width > MAX_VAT_TEXTURE_SIZE || layout.height > MAX_VAT_TEXTURE_SIZE)
+    {
+        UE_LOG(LogQuakeImporter, Error, TEXT("%s: VAT of %d vertices and %d poses needs %dx%d texels, over the maximum texture size."), *model.m_name, numVerts, numPoses, layout.width, layout.height);
+        return false;
+    }
+
+    return true;
+}
+
+void BuildAnimationData(const Alias& model, const AliasPoseRemap& remap, const VatLayout& layout, TArray<uint8>& out)
+{
+    QUAKE_IMPORT_SCOPE("BuildVat");
+
+    int numPoses = remap.rows.Num();
+
+    if (IsQuantizedVat())
+    {
+        // Keep the packed positions as they are in the mdl file. No flip here, the x axis
+        // flip is folded in the VatScale and VatOrigin material parameters.
+        const bool packNormals = GetDefault<UQuakeImportSettings>()->VatEncoding == EAliasVatEncoding::PackedNormalIndex;
+
+        out.SetNumZeroed(layout.width * layout.height * sizeof(FColor));
+        FColor* animationData = (FColor*)out.GetData();
+
+        for (int i = 0; i < numPoses; i++)
+        {
+            const AliasPoseView pose = model.GetPose(remap.rows[i]);
+
+            for (uint32 j = 0; j < model.m_numVerts; j++)
+            {
+                const uint8* position = pose.positions + (j * 3);
+                animationData[layout.TexelIndex(i, j)] = FColor(position[0], position[1], position[2], packNormals ? pose.normals[j] : 255);
+            }
+        }
+
+        return;
+    }
+
+    out.SetNumZeroed(layout.width * layout.height * sizeof(FFloat16Color));
+    FFloat16Color* animationData = (FFloat16Color*)out.GetData();
+
+    TArray<FVector3f> basePositions;
+    TArray<FVector3f> positions;
+    model.DecodePositions(model.GetPose(0), basePositions, true); // flip x axis
+
+    for (int i = 0; i < numPoses; i++)
+    {
+        model.DecodePositions(model.GetPose(remap.rows[i]), positions, true);
+
+        for (uint32 j = 0; j < model.m_numVerts; j++)
+        {
+            const FVector3f position = positions[j] - basePositions[j];
+
+            FFloat16Color color;
+
+            color.R = FFloat16(position.X);
+            color.G = FFloat16(position.Y);
+            color.B = FFloat16(position.Z);
+            color.A = 255;
+            animationData[layout.TexelIndex(i, j)] = color;
+        }
+    }
+}
+
+FColor EncodeVatNormal(const FVector3f& normal)
+{
+    return FColor(
+        (uint8)(((normal.X + 1) * 0.5f) * 255.0f),
+        (uint8)(((normal.Y + 1) * 0.5f) * 255.0f),
+        (uint8)(((normal.Z + 1) * 0.5f) * 255.0f),
+        255);
+}
+
+void BuildAnimationNormalData(const Alias& model, const AliasPoseRemap& remap, const VatLayout& layout, TArray<uint8>& out)
+{
+    QUAKE_IMPORT_SCOPE("BuildVat");
+
+    int numPoses = remap.rows.Num();
+
+    out.SetNumZeroed(layout.width * layout.height * sizeof(FColor));
+    FColor* normalData = (FColor*)out.GetData();
+
+    TArray<FVector3f> normals;
+
+    for (int i = 0; i < numPoses; i++)
+    {
+        model.DecodeNormals(model.GetPose(remap.rows[i]), normals, true); // flip x axis
+
+        for (uint32 j = 0; j < model.m_numVerts; j++)
+        {
+            normalData[layout.TexelIndex(i, j)] = EncodeVatNormal(normals[j]);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class Alias;
+struct AliasPoseRemap;
+
+/*
+============================================
+Alias vertex animation textures
+
+Layout and texel data of the _animation and _normal textures
+built from the poses kept by ReduceAliasPoses.
+============================================
+*/
+
+// Texel placement of every vertex of every pose in the VAT textures.
+// Linear is one row per pose. Tiled wraps each pose over rowsPerPose rows poseWidth texels wide,
+// and puts poseColumns poses side by side in each band of rows, to make a near square texture.
+struct VatLayout
+{
+    bool tiled;
+    int width;
+    int height;
+    int rowsPerPose;
+    int poseWidth;
+    int poseColumns;
+
+    int TexelIndex(int pose, int vertex) const
+    {
+        int x = (pose % poseColumns) * poseWidth + (vertex % poseWidth);
+        int y = (pose / poseColumns) * rowsPerPose + (vertex / poseWidth);
+        return (y * width) + x;
+    }
+
+    // Texel center of the vertex in pose 0, stored in UV channel 1. Pose n is offset by
+    // (n % poseColumns) * poseWidth / width in U and (n / poseColumns) * rowsPerPose / height in V.
+    // Linear is the same with rowsPerPose 1 and poseWidth width, one addressing scheme for both.
+    FVector2f VertexUV(int vertex) const
+    {
+        return FVector2f(
+            ((float)(vertex % poseWidth) + 0.5f) / width,
+            ((float)(vertex / poseWidth) + 0.5f) / height);
+    }
+};
+
+constexpr int MAX_VAT_TEXTURE_SIZE = 16384;
+
+// Quantized8 and PackedNormalIndex keep the packed mdl bytes, the others store float deltas
+bool IsQuantizedVat();
+
+// False when the VAT does not fit a texture even tiled
+bool ComputeVatLayout(const Alias& model, const AliasPoseRemap& remap, VatLayout& layout);
+
+// _animation texels in the VatEncoding format
+void BuildAnimationData(const Alias& model, const AliasPoseRemap& remap, const VatLayout& layout, TArray<uint8>& out);
+
+FColor EncodeVatNormal(const FVector3f& normal);
+
+// _normal texels, BGRA8
+void BuildAnimationNormalData(const Alias& model, const AliasPoseRemap& remap, const VatLayout& layout, TArray<uint8>& out);
@@ -0,0 +1,270 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BspFaceMerge.h"
+#include "ImportStats.h"
+
+namespace bsputils
+{
+    namespace
+    {
+        // Sine of the angle under which a corner counts as a straight edge
+        constexpr float COLINEAR_EPSILON = 0.001f;
+
+        FVector3f GetPoint(const bspformat29::Bsp_29& model, uint32 index)
+        {
+            const bspformat29::Point3f& p = model.vertices[index];
+            return FVector3f(p.x, p.y, p.z);
+        }
+
+        // Newell normal, follows the winding order whatever the plane side
+        FVector3f PolygonNormal(const bspformat29::Bsp_29& model, const TArray<uint32>& points)
+        {
+            FVector3f normal(0.0f, 0.0f, 0.0f);
+
+            for (int i = 0; i < points.Num(); i++)
+            {
+                FVector3f a = GetPoint(model, points[i]);
+                FVector3f b = GetPoint(model, points[(i + 1) % points.Num()]);
+
+                normal.X += (a.Y - b.Y) * (a.Z + b.Z);
+                normal.Y += (a.Z - b.Z) * (a.X + b.X);
+                normal.Z += (a.X - b.X) * (a.Y + b.Y);
+            }
+
+            return normal.GetSafeNormal();
+        }
+
+        enum class ECorner
+        {
+            Convex,
+            Straight,
+            Reflex
+        };
+
+        ECorner ClassifyCorner(const bspformat29::Bsp_29& model, const TArray<uint32>& points, int i, const FVector3f& normal)
+        {
+            const int num = points.Num();
+            FVector3f prev = GetPoint(model, points[(i + num - 1) % num]);
+            FVector3f curr = GetPoint(model, points[i]);
+            FVector3f next = GetPoint(model, points[(i + 1) % num]);
+
+            FVector3f in = (curr - prev).GetSafeNormal();
+            FVector3f out = (next - curr).GetSafeNormal();
+            float turn = FVector3f::DotProduct(FVector3f::CrossProduct(in, out), normal);
+
+            if (FMath::Abs(turn) <= COLINEAR_EPSILON)
+            {
+                // Straight on, or folding back onto itself
+                return FVector3f::DotProduct(in, out) > 0.0f ? ECorner::Straight : ECorner::Reflex;
+            }
+
+            return turn > 0.0f ? ECorner::Convex : ECorner::Reflex;
+        }
+
+        // Join two polygons over edge i of a, which b has in the opposite direction. False if b
+        // does not have it or the result would not be convex.
+        bool TryMerge(const bspformat29::Bsp_29& model, const FacePolygon& a, int i, const FacePolygon& b, const FVector3f& normal, FacePolygon& out)
+        {
+            const int numA = a.points.Num();
+            const int numB = b.points.Num();
+
+            uint32 p1 = a.points[i];
+            uint32 p2 = a.points[(i + 1) % numA];
+
+            for (int j = 0; j < numB; j++)
+            {
+                if (b.points[j] != p2 || b.points[(j + 1) % numB] != p1)
+                {
+                    continue;
+                }
+
+                // a from p2 round to p1, then b strictly between p1 and p2
+                out = a;
+                out.points.Reset();
+
+                for (int k = 1; k <= numA; k++)
+                {
+                    out.points.Add(a.points[(i + k) % numA]);
+                }
+
+                for (int k = 2; k < numB; k++)
+                {
+                    out.points.Add(b.points[(j + k) % numB]);
+                }
+
+                // More than one shared edge would repeat a point
+                TSet<uint32> unique(out.points);
+
+                if (unique.Num() != out.points.Num())
+                {
+                    return false;
+                }
+
+                for (int k = 0; k < out.points.Num(); k++)
+                {
+                    if (ClassifyCorner(model, out.points, k, normal) == ECorner::Reflex)
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            return false;
+        }
+
+        // Directed edge of a polygon to the polygon owning it, the neighbour across has the reverse edge
+        using FaceEdge = TPair<uint32, uint32>;
+
+        void AddEdges(TMap<FaceEdge, int>& edges, const FacePolygon& polygon, int face)
+        {
+            const int num = polygon.points.Num();
+
+            for (int i = 0; i < num; i++)
+            {
+                edges.Add(FaceEdge(polygon.points[i], polygon.points[(i + 1) % num]), face);
+            }
+        }
+
+        void RemoveEdges(TMap<FaceEdge, int>& edges, const FacePolygon& polygon, int face)
+        {
+            const int num = polygon.points.Num();
+
+            for (int i = 0; i < num; i++)
+            {
+                FaceEdge edge(polygon.points[i], polygon.points[(i + 1) % num]);
+                const int* owner = edges.Find(edge);
+
+                if (owner && *owner == face)
+                {
+                    edges.Remove(edge);
+                }
+            }
+        }
+    }
+
+    void MergeCoplanarFaces(const bspformat29::Bsp_29& model, TArray<FacePolygon>& polygons)
+    {
+        QUAKE_IMPORT_SCOPE("MergeCoplanarFaces");
+
+        // Only polygons on the same plane, side and texinfo can merge
+        TMap<TTuple<int, int, int>, TArray<FacePolygon>> groups;
+
+        for (FacePolygon& polygon : polygons)
+        {
+            groups.FindOrAdd(MakeTuple(polygon.planenum, polygon.side, polygon.texinfo)).Add(MoveTemp(polygon));
+        }
+
+        polygons.Reset();
+
+        for (TPair<TTuple<int, int, int>, TArray<FacePolygon>>& group : groups)
+        {
+            TArray<FacePolygon>& faces = group.Value;
+            const FVector3f normal = PolygonNormal(model, faces[0].points);
+
+            // Only polygons across a shared edge are tried, not every pair of the group
+            TMap<FaceEdge, int> edges;
+            TArray<bool> removed;
+            removed.SetNumZeroed(faces.Num());
+
+            for (int i = 0; i < faces.Num(); i++)
+            {
+                AddEdges(edges, faces[i], i);
+            }
+
+            for (int i = 0; i < faces.Num(); i++)
+            {
+                for (int k = 0; !removed[i] && k < faces[i].points.Num(); k++)
+                {
+                    const int num = faces[i].points.Num();
+                    const int* neighbour = edges.Find(FaceEdge(faces[i].points[(k + 1) % num], faces[i].points[k]));
+
+                    if (!neighbour || *neighbour == i)
+                    {
+                        continue;
+                    }
+
+                    const int j = *neighbour;
+                    FacePolygon result;
+
+                    if (TryMerge(model, faces[i], k, faces[j], normal, result))
+                    {
+                        RemoveEdges(edges, faces[i], i);
+                        RemoveEdges(edges, faces[j], j);
+                        removed[j] = true;
+
+                        faces[i] = MoveTemp(result);
+                        AddEdges(edges, faces[i], i);
+
+                        k = -1; // the larger polygon may now touch others, walk its edges again
+                    }
+                }
+            }
+
+            for (int i = 0; i < faces.Num(); i++)
+            {
+                if (!removed[i])
+                {
+                    polygons.Add(MoveTemp(faces[i]));
+                }
+            }
+        }
+
+        // Straight edge points are only safe to drop when no other polygon ends an edge there
+        TMap<uint32, int> uses;
+
+        for (const FacePolygon& polygon : polygons)
+        {
+            for (uint32 point : polygon.points)
+            {
+                uses.FindOrAdd(point)++;
+            }
+        }
+
+        for (FacePolygon& polygon : polygons)
+        {
+            const FVector3f normal = PolygonNormal(model, polygon.points);
+
+            for (int i = polygon.points.Num(); i-- > 0 && polygon.points.Num() > 3;)
+            {
+                if (uses[polygon.points[i]] == 1 && ClassifyCorner(model, polygon.points, i, normal) == ECorner::Straight)
+                {
+                    polygon.points.RemoveAt(i);
+                }
+            }
+        }
+    }
+
+    void TriangulatePolygon(const bspformat29::Bsp_29& model, const TArray<uint32>& points, TArray<int32>& outCorners)
+    {
+        const int num = points.Num();
+
+        if (num < 3)
+        {
+            return;
+        }
+
+        const FVector3f normal = PolygonNormal(model, points);
+        int start = 0;
+
+        for (int i = 0; i < num; i++)
+        {
+            if (ClassifyCorner(model, points, i, normal) == ECorner::Convex &&
+                ClassifyCorner(model, points, (i + 1) % num, normal) == ECorner::Convex &&
+                ClassifyCorner(model, points, (i + num - 1) % num, normal) == ECorner::Convex)
+            {
+                start = i;
+                break;
+            }
+        }
+
+        for (int i = 1; i < num - 1; i++)
+        {
+            outCorners.Add(start);
+            outCorners.Add((start + i) % num);
+            outCorners.Add((start + i + 1) % num);
+        }
+    }
+
+} // namespace bsputils
@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BspUtilities.h"
+
+/*
+============================================
+Bsp face merge
+
+The Quake compiler splits faces along BSP planes and every 240 units
+for its software lightmaps. Adjacent faces on the same plane, side and
+texinfo are merged back into larger convex polygons, the way qbsp
+merges brush faces before splitting them. Points left in the middle of
+a straight edge are dropped unless another face still uses them, so no
+T-junctions are created.
+============================================
+*/
+
+namespace bsputils
+{
+    // Convex polygon of vertex indices, in the winding order the mesh is built with
+    struct FacePolygon
+    {
+        int             planenum;
+        int             side;
+        int             texinfo;
+        TArray<uint32>  points;
+    };
+
+    // Merge adjacent coplanar polygons sharing plane, side and texinfo in place
+    void MergeCoplanarFaces(const bspformat29::Bsp_29& model, TArray<FacePolygon>& polygons);
+
+    // Fan triangulation of a convex polygon as triples of indices into points.
+    // The fan starts at a corner no straight edge point is next to, so kept colinear points make no degenerate triangles.
+    void TriangulatePolygon(const bspformat29::Bsp_29& model, const TArray<uint32>& points, TArray<int32>& outCorners);
+
+} // namespace bsputils
@@ -15,11 +15,22 @@
 #include "Editor/EditorEngine.h"
 #include "Editor.h"
 #include "UObject/UObjectGlobals.h"
+#include "Engine/StaticMesh.h"
 #include "Engine/StaticMeshActor.h"
+#include "Hash/CityHash.h"
+#include "Misc/ScopedSlowTask.h"
+#include "Tasks/Task.h"
+
+#include <atomic>
 
 // Quake Import
+#include "BspLightmap.h"
 #include "BspUtilities.h"
 #include "EntityMaker.h"
+#include "LiquidVolumes.h"
+#include "QuakeImportSettings.h"
+#include "ImportSession.h"
+#include "ImportStats.h"
 
 DEFINE_LOG_CATEGORY(LogQuakeImporter);
 
@@ -50,37 +61,257 @@ bool FindPlayerStart(const TArray<AttributeGroup>& entities)
     return false;
 }
 
+// Palette expanded pixels of one texture, prepared on a worker task
+struct PreparedTexture
+{
+    FString         name;           // asset name, CreateUTexture2DFromBGRA appends _color
+    FString         materialName;   // empty when no material samples this texture
+    QuakeCommon::EQuakeMaterial surface = QuakeCommon::EQuakeMaterial::Opaque;
+    int             numFrames = 1;  // of a flipbook
+    int             width = 0;
+    int             height = 0;
+    uint64          hash = 0;       // of the palette indices, like earlier imports
+    TArray<uint8>   bgra;
+};
+
+PreparedTexture& PrepareTexture(const FString& name, const FString& materialName, int width, int height, const TArray<uint8>& indices, const TArray<QuakeCommon::QColor>& pal, TArray<PreparedTexture>& out)
+{
+    PreparedTexture& prepared = out.AddDefaulted_GetRef();
+    prepared.name = name;
+    prepared.materialName = materialName;
+    prepared.width = width;
+    prepared.height = height;
+    prepared.hash = CityHash64WithSeed((const char*)indices.GetData(), indices.Num(), (uint64(width) << 32) | uint64(height));
+
+    QuakeCommon::ExpandPalette(indices, pal, prepared.bgra);
+
+    return prepared;
+}
+
+// Pixels of the textures and materials made from one miptex. Safe on any thread.
+void PrepareMiptex(const bsputils::bspformat29::Bsp_29& model, const bsputils::bspformat29::Texture& it, const TArray<QuakeCommon::QColor>& pal, TArray<PreparedTexture>& out)
+{
+    QUAKE_IMPORT_SCOPE("PrepareTexture");
+
+    if (it.name.StartsWith("sky"))
+    {
+        // sky texture split the data buffer at the center and create 2 textures _front and _back
+        TArray<uint8> front;
+        TArray<uint8> back;
+
+        for (unsigned i = 0; i < it.height; i++)
+        {
+            for (unsigned j = 0; j < it.width; j++)
+            {
+                unsigned pos = (i * it.width) + j;
+
+                if (j < it.width / 2)
+                {
+                    front.Add(it.mip0[pos]);
+                }
+                else
+                {
+                    back.Add(it.mip0[pos]);
+                }
+            }
+        }
+
+        PrepareTexture(it.name + "_front", FString(), it.width / 2, it.height, front, pal, out);
+        PrepareTexture(it.name + "_back", it.name, it.width / 2, it.height, back, pal, out).surface = QuakeCommon::EQuakeMaterial::Sky;
+    }
+    else if (it.name.StartsWith("+0"))
+    {
+        // First flipbook frame. Append the rest.
+        TArray<uint8> data;
+
+        // append first frame data
+        data.Append(it.mip0);
+
+        int numFrames = 1;
+
+        while (bsputils::AppendNextTextureData(it.name, numFrames, model, data))
+        {
+            numFrames++;
+        }
+
+        PreparedTexture& prepared = PrepareTexture(it.name, it.name, it.width, it.height * numFrames, data, pal, out);
+        prepared.surface = QuakeCommon::EQuakeMaterial::Flipbook;
+        prepared.numFrames = numFrames;
+    }
+    else
+    {
+        PreparedTexture& prepared = PrepareTexture(it.name, it.name, it.width, it.height, it.mip0, pal, out);
+
+        if (it.name.StartsWith("*"))
+        {
+            prepared.surface = QuakeCommon::EQuakeMaterial::Liquid;
+        }
+    }
+}
+
+// Create the texture, or refresh its pixels when the miptex data changed since the last import
+UTexture2D* ImportTexture(const PreparedTexture& prepared, UPackage& texturePackage, int& rebuilt)
+{
+    UTexture2D* texture = (UTexture2D*)QuakeCommon::CheckIfAssetExist<UTexture2D>(prepared.name + "_color", texturePackage);
+
+    if (texture)
+    {
+        if (QuakeCommon::IsImportHashCurrent(*texture, prepared.hash))
+        {
+            return texture;
+        }
+
+        QuakeCommon::UpdateUTexture2D(*texture, prepared.width, prepared.height, prepared.bgra);
+    }
+    else
+    {
+        texture = QuakeCommon::CreateUTexture2DFromBGRA(prepared.name, prepared.width, prepared.height, prepared.bgra, texturePackage);
+    }
+
+    if (texture)
+    {
+        QuakeCommon::SetImportHash(*texture, prepared.hash);
+        rebuilt++;
+    }
+
+    return texture;
+}
+
+// Lightmap memory of the final mesh resolutions. Rebuilt meshes carry the page PackLightmapUVs
+// settled on, which can be larger than requested, current meshes keep the one they were built with.
+int64 FinalLightmapBytes(UPackage& modelPackage, const TArray<int>& requested, const TArray<bsputils::SubmodelMeshData>& meshes)
+{
+    TArray<int> resolutions = requested;
+    TBitArray<> rebuilt(false, requested.Num());
+
+    for (const bsputils::SubmodelMeshData& mesh : meshes)
+    {
+        resolutions[mesh.id] = mesh.lightmapResolution;
+        rebuilt[mesh.id] = true;
+    }
+
+    int64 bytes = 0;
+
+    for (int i = 0; i < resolutions.Num(); i++)
+    {
+        if (!rebuilt[i] && resolutions[i] > 0)
+        {
+            UStaticMesh* existing = Cast<UStaticMesh>(QuakeCommon::CheckIfAssetExist<UStaticMesh>(FString("submodel_") + FString::FromInt(i), modelPackage));
+
+            if (existing)
+            {
+                resolutions[i] = existing->LightMapResolution;
+            }
+        }
+
+        bytes += bsputils::LightmapBytes(resolutions[i]);
+    }
+
+    return bytes;
+}
+
+// Wait for worker tasks, keeping the progress dialog responsive. False once the user cancelled,
+// the tasks are still waited for since they reference the caller's data.
+bool WaitForTasks(const TArray<UE::Tasks::FTask>& tasks, FScopedSlowTask& slowTask, std::atomic<bool>& cancelled)
+{
+    while (!UE::Tasks::Wait(tasks, FTimespan::FromMilliseconds(50)))
+    {
+        slowTask.TickProgress();
+
+        if (slowTask.ShouldCancel())
+        {
+            cancelled = true;
+        }
+    }
+
+    if (slowTask.ShouldCancel())
+    {
+        cancelled = true;
+    }
+
+    return !cancelled;
+}
+
+void CreateLiquidVolumes(UWorld& world, const bsputils::bspformat29::Bsp_29& model)
+{
+    const UQuakeImportSettings* settings = GetDefault<UQuakeImportSettings>();
+
+    TArray<bsputils::LiquidVolume> volumes;
+
+    if (settings->bLiquidVolumes)
+    {
+        bsputils::BuildLiquidVolumes(model, settings->LiquidMergeTolerance, volumes);
+    }
+
+    bsputils::SpawnLiquidVolumes(world, volumes);
+}
+
 UObject* UBspFactory::FactoryCreateBinary(UClass* InClass, UObject* InParent, FName Name, EObjectFlags Flags, UObject* Context, const TCHAR* Type, const uint8*& Buffer, const uint8* BufferEnd, FFeedbackContext* Warn)
 {
     using namespace bsputils;
 
+    QuakeCommon::ImportReport report(TEXT("Bsp"), Name.ToString());
+    QuakeCommon::ImportSession session;
+
+    // Parsing, pixel conversion and mesh preparation run as worker tasks. UObjects are only
+    // created on the game thread, between waits that keep the progress dialog responsive.
+    FScopedSlowTask slowTask(5.0f, FText::Format(LOCTEXT("ImportingBsp", "Importing {0}"), FText::FromName(Name)));
+    slowTask.MakeDialog(true);
+
+    std::atomic<bool> cancelled(false);
+    TArray<UE::Tasks::FTask> allTasks;
+
+    // Cancelled imports wait for their tasks. Cancel points all come before the first asset
+    // is modified, a cancelled import leaves the loaded assets and their packages untouched.
+    auto Cancel = [&]() -> UObject*
+    {
+        cancelled = true;
+        UE::Tasks::Wait(allTasks);
+        UE_LOG(LogQuakeImporter, Warning, TEXT("Import of '%s' cancelled, nothing saved."), *Name.ToString());
+        return nullptr;
+    };
+
     // Create Packages
     FString worldPackageName = TEXT("/Game/Maps/") / Name.ToString();
     FString modelPackageName = TEXT("/Game/Models/") / Name.ToString() / Name.ToString();
-    FString texturePackageName = TEXT("/Game/Textures/Textures");
-    FString materialsPackageName = TEXT("/Game/Textures/Materials");
+    FString texturePackageName = TEXTURE_PACKAGE_NAME;
+    FString materialsPackageName = MATERIAL_PACKAGE_NAME;
 
     UPackage* worldPackage = CreatePackage(nullptr, *worldPackageName);
     UPackage* modelPackage = CreatePackage(nullptr, *modelPackageName);
-    UPackage* texturePackage = CreatePackage(nullptr, *texturePackageName);
-    UPackage* materialPackage = CreatePackage(nullptr, *materialsPackageName);
+
+    // Shared or one package per asset depending on the project settings
+    QuakeCommon::ImportPackages texturePackages(texturePackageName);
+    QuakeCommon::ImportPackages materialPackages(materialsPackageName);
 
     //worldPackage->FullyLoad();
     //modelPackage->FullyLoad();
-    //texturePackage->FullyLoad();
-    //materialPackage->FullyLoad();
 
-    // Check if we already have this world package
+    // Check if we already have this world package. If so this is a reimport and only the
+    // submodels, textures and entities whose content hash changed are rebuilt.
+    UWorld* existingWorld = LoadObject<UWorld>(NULL, *(worldPackageName + TEXT(".") + Name.ToString()), nullptr, LOAD_Quiet | LOAD_NoWarn);
 
-    if (LoadObject<UWorld>(NULL, *worldPackageName, nullptr, LOAD_Quiet | LOAD_NoWarn))
+    // Load Palette
+    TArray<QuakeCommon::QColor> quakePalette;
+    if (!QuakeCommon::LoadPalette(quakePalette))
     {
-        UE_LOG(LogQuakeImporter, Error, TEXT("Failed to import bsp file '%s'. Reimport not supported."), *Name.ToString());
+        UE_LOG(LogQuakeImporter, Error, TEXT("Palette.lmp not found."));
         return nullptr;
     }
 
-    // Create Submodels
-    BspLoader* loader = new BspLoader();
-    loader->Load(Buffer);
+    // Parse
+    slowTask.EnterProgressFrame(1.0f, LOCTEXT("ParsingBsp", "Parsing"));
+
+    BspLoader* loader = &session.Own(MakeUnique<BspLoader>());
+    const uint8* data = Buffer;
+
+    allTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [loader, data]() mutable { loader->Load(data); }));
+
+    if (!WaitForTasks(allTasks, slowTask, cancelled))
+    {
+        return Cancel();
+    }
+
     const bspformat29::Bsp_29* model = loader->GetBspPtr();
 
     if (!model)
@@ -89,85 +320,141 @@ UObject* UBspFactory::FactoryCreateBinary(UClass* InClass, UObject* InParent, FN
         return nullptr;
     }
 
-    // Load Palette
-    TArray<QuakeCommon::QColor> quakePalette;
-    if (!QuakeCommon::LoadPalette(quakePalette))
-    {
-        UE_LOG(LogQuakeImporter, Error, TEXT("Palette.lmp not found."));
-        return nullptr;
-    }
+    // Independent stages from the parsed model: texture pixels, entities and lightmap sizes
+    slowTask.EnterProgressFrame(1.0f, LOCTEXT("PreparingBsp", "Converting textures and meshes"));
 
-    // Create Textures and Materials
-    for (const auto& it : model->textures)
+    TArray<TArray<PreparedTexture>> preparedTextures;
+    preparedTextures.SetNum(model->textures.Num());
+
+    for (int i = 0; i < model->textures.Num(); i++)
     {
-        if (it.name.StartsWith("sky"))
+        allTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [&, i]()
         {
-            // sky texture split the data buffer at the center and create 2 textures _front and _back
-            TArray<uint8> front;
-            TArray<uint8> back;
-
-            for (unsigned i = 0; i < it.height; i++)
+            if (!cancelled)
             {
-                for (unsigned j = 0; j < it.width; j++)
-                {
-                    unsigned pos = (i * it.width) + j;
-
-                    if (j < it.width / 2)
-                    {
-                        front.Add(it.mip0[pos]);
-                    }
-                    else
-                    {
-                        back.Add(it.mip0[pos]);
-                    }
-                }
+                PrepareMiptex(*model, model->textures[i], quakePalette, preparedTextures[i]);
             }
+        }));
+    }
 
-            QuakeCommon::CreateUTexture2D(it.name + "_front", it.width / 2, it.height, front, *texturePackage, quakePalette);
-            UTexture2D* skyTexture = QuakeCommon::CreateUTexture2D(it.name + "_back", it.width / 2, it.height, back, *texturePackage, quakePalette);
+    // Deserialize entities
+    TArray<AttributeGroup> entities;
+    allTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [&]() { DeserializeGroup(model->entities, entities); }));
 
-            QuakeCommon::CreateUMaterial(it.name, *materialPackage, *skyTexture);
-        }
-        else if (it.name.StartsWith("+0"))
+    // Lightmap resolutions depend on every submodel through the map budget, settle them before any mesh
+    TArray<int> lightmapResolutions;
+    TArray<uint64> submodelHashes;
+
+    UE::Tasks::FTask lightmapTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [&]()
+    {
+        ComputeLightmapResolutions(*model, lightmapResolutions);
+
+        for (int i = 0; i < model->submodels.Num() && !cancelled; i++)
         {
-            // First flipbook frame. Append the rest.
-            TArray<uint8> data;
+            submodelHashes.Add(SubmodelImportHash(*model, i, lightmapResolutions[i]));
+        }
+    });
+
+    allTasks.Add(lightmapTask);
+
+    if (!WaitForTasks({ lightmapTask }, slowTask, cancelled))
+    {
+        return Cancel();
+    }
 
-            // append first frame data
-            data.Append(it.mip0);
+    // Submodels whose mesh is current are left untouched, the others are prepared in the background
+    TArray<SubmodelMeshData> meshes;
+    meshes.Reserve(model->submodels.Num());
 
-            int numFrames = 1;
+    for (int i = 0; i < model->submodels.Num(); i++)
+    {
+        if (!IsSubmodelCurrent(*modelPackage, i, submodelHashes[i]))
+        {
+            meshes.AddDefaulted_GetRef().id = i;
+        }
+    }
 
-            while (AppendNextTextureData(it.name, numFrames, *model, data))
+    for (SubmodelMeshData& mesh : meshes)
+    {
+        SubmodelMeshData* target = &mesh;
+
+        allTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [&, target]()
+        {
+            if (!cancelled)
             {
-                numFrames++;
+                PrepareSubmodelMesh(*model, target->id, lightmapResolutions[target->id], *target);
             }
+        }));
+    }
 
-            UTexture2D* flipbookTexture = QuakeCommon::CreateUTexture2D(it.name, it.width, it.height * numFrames, data, *texturePackage, quakePalette);
-            QuakeCommon::CreateUMaterial(it.name, *materialPackage, *flipbookTexture);
-        }
-        else
+    // Last cancel point, every stage below only applies the prepared data to the assets
+    if (!WaitForTasks(allTasks, slowTask, cancelled))
+    {
+        return Cancel();
+    }
+
+    const int64 lightmapBytes = FinalLightmapBytes(*modelPackage, lightmapResolutions, meshes);
+    const float lightmapBudgetMB = GetDefault<UQuakeImportSettings>()->LightmapBudgetMB;
+
+    if (lightmapBudgetMB > 0.0f && lightmapBytes > (int64)(lightmapBudgetMB * 1024.0 * 1024.0))
+    {
+        UE_LOG(LogQuakeImporter, Warning, TEXT("%s: lightmaps take %.2f MB after packing, over the %.2f MB budget."), *Name.ToString(), lightmapBytes / (1024.0 * 1024.0), lightmapBudgetMB);
+    }
+    else
+    {
+        UE_LOG(LogQuakeImporter, Log, TEXT("%s: lightmaps take %.2f MB after packing."), *Name.ToString(), lightmapBytes / (1024.0 * 1024.0));
+    }
+
+    // Create Textures and Materials
+    slowTask.EnterProgressFrame(1.0f, LOCTEXT("CreatingTextures", "Creating textures and materials"));
+
+    int texturesRebuilt = 0;
+
+    for (const TArray<PreparedTexture>& miptex : preparedTextures)
+    {
+        for (const PreparedTexture& prepared : miptex)
         {
-            UTexture2D* texture = QuakeCommon::CreateUTexture2D(it.name, it.width, it.height, it.mip0, *texturePackage, quakePalette);
+            UTexture2D* texture = ImportTexture(prepared, texturePackages.ForAsset(prepared.name + "_color"), texturesRebuilt);
 
-            if (texture)
+            if (texture && !prepared.materialName.IsEmpty())
             {
-                QuakeCommon::CreateUMaterial(it.name, *materialPackage, *texture);
+                QuakeCommon::CreateUMaterial(prepared.materialName, materialPackages.ForAsset(prepared.materialName), *texture, prepared.surface, prepared.numFrames);
             }
         }
-    }
 
-    // Deserialize entities
-    TArray<AttributeGroup> entities;
-    DeserializeGroup(model->entities, entities);
+        slowTask.TickProgress();
+    }
 
     // Add Submodels
-    ModelToStaticmeshes(*model, *modelPackage, *materialPackage);
+    slowTask.EnterProgressFrame(1.0f, LOCTEXT("CreatingMeshes", "Building static meshes"));
 
-    // Look for info_player_start. Map found without this are just normal pickup items made out of BSP.
+    for (const SubmodelMeshData& mesh : meshes)
+    {
+        CreateSubmodel(*modelPackage, mesh, materialPackages);
+        slowTask.TickProgress();
+    }
+
+    UE_LOG(LogQuakeImporter, Log, TEXT("Imported '%s': %d/%d submodels and %d textures rebuilt."), *Name.ToString(), meshes.Num(), model->submodels.Num(), texturesRebuilt);
+
+    // World and entities
+    slowTask.EnterProgressFrame(1.0f, LOCTEXT("CreatingWorld", "Placing entities"));
 
-    if (FindPlayerStart(entities))
+    if (existingWorld)
     {
+        if (!existingWorld->bIsWorldInitialized)
+        {
+            existingWorld->WorldType = EWorldType::Inactive;
+            existingWorld->InitWorld(UWorld::InitializationValues().AllowAudioPlayback(false).CreatePhysicsScene(false).ShouldSimulatePhysics(false).CreateFXSystem(false));
+        }
+
+        // Submodel 0 was rebuilt in place, only the entities need syncing
+        EntityMaker(*existingWorld, entities);
+        CreateLiquidVolumes(*existingWorld, *model);
+    }
+    else if (FindPlayerStart(entities))
+    {
+        // Look for info_player_start. Map found without this are just normal pickup items made out of BSP.
+
         // Create a new world.
         UWorld* world = UWorld::CreateWorld(EWorldType::Inactive, false, Name, Cast<UPackage>(worldPackage), true, ERHIFeatureLevel::Num);
         world->SetFlags(Flags);
@@ -191,12 +478,21 @@ UObject* UBspFactory::FactoryCreateBinary(UClass* InClass, UObject* InParent, FN
 
         // Add entitites
         EntityMaker(*world, entities);
+        CreateLiquidVolumes(*world, *model);
+    }
+
+    if (!existingWorld || worldPackage->IsDirty())
+    {
+        QuakeCommon::SavePackage(*worldPackage);
+    }
+
+    if (modelPackage->IsDirty())
+    {
+        QuakeCommon::SavePackage(*modelPackage);
     }
 
-    QuakeCommon::SavePackage(*worldPackage);
-    QuakeCommon::SavePackage(*modelPackage);
-    QuakeCommon::SavePackage(*texturePackage);
-    QuakeCommon::SavePackage(*materialPackage);
+    texturePackages.SaveDirty();
+    materialPackages.SaveDirty();
 
     return worldPackage;
 }
@@ -0,0 +1,368 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BspHulls.h"
+#include "ImportStats.h"
+
+// Epic
+#include "Hash/CityHash.h"
+
+namespace bsputils
+{
+    namespace
+    {
+        constexpr float ON_EPSILON = 0.1f;
+        constexpr float MAX_WORLD_EXTENT = 65536.0f;
+
+        // Merge points closer than this when gathering region corners
+        constexpr float POINT_EPSILON = 0.01f;
+
+        HullPlane GetPlane(const bspformat29::Bsp_29& model, int planenum, int side)
+        {
+            const bspformat29::Plane& plane = model.planes[planenum];
+            HullPlane out = { FVector3f(plane.normal[0], plane.normal[1], plane.normal[2]), plane.dist };
+
+            if (side)
+            {
+                // back child, keep the other half space
+                out.normal = -out.normal;
+                out.dist = -out.dist;
+            }
+
+            return out;
+        }
+
+        struct HullWalk
+        {
+            const bspformat29::Bsp_29&  model;
+            int                         hull;
+            ELeafContentType            contents;
+            TArray<HullPlane>           planes;
+            TArray<HullRegion>&         out;
+            TArray<int8>                uniform;    // per node of the walked tree, -1 until IsUniform computes it
+
+            void Emit()
+            {
+                HullRegion region;
+                region.contents = contents;
+
+                if (BuildRegion(planes, region.points, region.volume))
+                {
+                    out.Add(MoveTemp(region));
+                }
+            }
+
+            // True when every leaf under the node has the walked contents. Each node is computed
+            // once from its children, the walk asks again for every node on the way down.
+            // Children are validated by BspLoader, in range and after their parent.
+            bool IsUniformNode(int node)
+            {
+                if (uniform[node] < 0)
+                {
+                    const bspformat29::Node& n = model.nodes[node];
+                    bool result = true;
+
+                    for (int side = 0; side < 2 && result; side++)
+                    {
+                        int child = n.children[side];
+                        result = child >= 0 ? IsUniformNode(child) : model.leaves[-1 - child].contents == contents;
+                    }
+
+                    uniform[node] = result ? 1 : 0;
+                }
+
+                return uniform[node] != 0;
+            }
+
+            bool IsUniformClipNode(int node)
+            {
+                if (uniform[node] < 0)
+                {
+                    const bspformat29::ClipNode& n = model.clipnodes[node];
+                    bool result = true;
+
+                    for (int side = 0; side < 2 && result; side++)
+                    {
+                        int child = n.children[side];
+                        result = child >= 0 ? IsUniformClipNode(child) : (ELeafContentType)child == contents;
+                    }
+
+                    uniform[node] = result ? 1 : 0;
+                }
+
+                return uniform[node] != 0;
+            }
+
+            void WalkNode(int node)
+            {
+                // Leaves the compiler split for faces but with the same contents make up the node region, one convex
+                if (IsUniformNode(node))
+                {
+                    Emit();
+                    return;
+                }
+
+                const bspformat29::Node& n = model.nodes[node];
+
+                for (int side = 0; side < 2; side++)
+                {
+                    planes.Push(GetPlane(model, n.planenum, side));
+
+                    int child = n.children[side];
+
+                    if (child >= 0)
+                    {
+                        WalkNode(child);
+                    }
+                    else if (model.leaves[-1 - child].contents == contents)
+                    {
+                        Emit();
+                    }
+
+                    planes.Pop();
+                }
+            }
+
+            void WalkClipNode(int node)
+            {
+                if (IsUniformClipNode(node))
+                {
+                    Emit();
+                    return;
+                }
+
+                const bspformat29::ClipNode& n = model.clipnodes[node];
+
+                for (int side = 0; side < 2; side++)
+                {
+                    planes.Push(GetPlane(model, n.planenum, side));
+
+                    int child = n.children[side];
+
+                    if (child >= 0)
+                    {
+                        WalkClipNode(child);
+                    }
+                    else if ((ELeafContentType)child == contents)
+                    {
+                        Emit();
+                    }
+
+                    planes.Pop();
+                }
+            }
+        };
+    }
+
+    Winding BaseWindingForPlane(const HullPlane& plane)
+    {
+        // Pick the major axis to build the plane basis from, like qbsp
+        FVector3f up(0.0f, 0.0f, 1.0f);
+
+        if (FMath::Abs(plane.normal.Z) > FMath::Abs(plane.normal.X) && FMath::Abs(plane.normal.Z) > FMath::Abs(plane.normal.Y))
+        {
+            up = FVector3f(1.0f, 0.0f, 0.0f);
+        }
+
+        up = (up - plane.normal * FVector3f::DotProduct(up, plane.normal)).GetSafeNormal();
+        FVector3f right = FVector3f::CrossProduct(up, plane.normal);
+
+        FVector3f origin = plane.normal * plane.dist;
+        up *= MAX_WORLD_EXTENT;
+        right *= MAX_WORLD_EXTENT;
+
+        Winding out;
+        out.Add(origin - right + up);
+        out.Add(origin + right + up);
+        out.Add(origin + right - up);
+        out.Add(origin - right - up);
+        return out;
+    }
+
+    Winding ClipWinding(const Winding& in, const HullPlane& plane)
+    {
+        Winding out;
+
+        if (!in.Num())
+        {
+            return out;
+        }
+
+        TArray<float, TInlineAllocator<32>> dists;
+
+        for (const FVector3f& point : in)
+        {
+            dists.Add(FVector3f::DotProduct(point, plane.normal) - plane.dist);
+        }
+
+        for (int i = 0; i < in.Num(); i++)
+        {
+            int next = (i + 1) % in.Num();
+            float d0 = dists[i];
+            float d1 = dists[next];
+
+            if (d0 >= -ON_EPSILON)
+            {
+                out.Add(in[i]);
+            }
+
+            // Edge crosses the plane
+            if ((d0 > ON_EPSILON && d1 < -ON_EPSILON) || (d0 < -ON_EPSILON && d1 > ON_EPSILON))
+            {
+                float t = d0 / (d0 - d1);
+                out.Add(in[i] + (in[next] - in[i]) * t);
+            }
+        }
+
+        if (out.Num() < 3)
+        {
+            out.Empty();
+        }
+
+        return out;
+    }
+
+    bool BuildRegion(const TArray<HullPlane>& planes, TArray<FVector3f>& outPoints, float& outVolume)
+    {
+        outPoints.Reset();
+        outVolume = 0.0f;
+
+        // Every face of the region is its plane clipped by all the others
+        for (int i = 0; i < planes.Num(); i++)
+        {
+            Winding winding = BaseWindingForPlane(planes[i]);
+
+            for (int j = 0; j < planes.Num() && winding.Num(); j++)
+            {
+                if (i != j)
+                {
+                    winding = ClipWinding(winding, planes[j]);
+                }
+            }
+
+            // Pyramid from the first corner to the face, the planes face into the region
+            if (winding.Num() && outPoints.Num())
+            {
+                FVector3f cross(0.0f, 0.0f, 0.0f);
+
+                for (int k = 1; k + 1 < winding.Num(); k++)
+                {
+                    cross += FVector3f::CrossProduct(winding[k] - winding[0], winding[k + 1] - winding[0]);
+                }
+
+                float height = FVector3f::DotProduct(outPoints[0], planes[i].normal) - planes[i].dist;
+                outVolume += cross.Size() * 0.5f * FMath::Max(0.0f, height) / 3.0f;
+            }
+
+            for (const FVector3f& point : winding)
+            {
+                bool found = false;
+
+                for (const FVector3f& existing : outPoints)
+                {
+                    if (existing.Equals(point, POINT_EPSILON))
+                    {
+                        found = true;
+                        break;
+                    }
+                }
+
+                if (!found)
+                {
+                    outPoints.Add(point);
+                }
+            }
+        }
+
+        if (outPoints.Num() < 4)
+        {
+            return false;
+        }
+
+        // Reject flat regions, they have no volume for a convex element
+        FBox3f box(outPoints);
+        FVector3f size = box.GetSize();
+        return size.GetMin() > ON_EPSILON;
+    }
+
+    void BuildHullRegions(const bspformat29::Bsp_29& model, int submodel, int hull, ELeafContentType contents, float margin, TArray<HullRegion>& out)
+    {
+        QUAKE_IMPORT_SCOPE("BuildHullRegions");
+
+        const bspformat29::SubModel& sm = model.submodels[submodel];
+        int headnode = sm.headnode[hull];
+
+        HullWalk walk = { model, hull, contents, {}, out };
+        walk.uniform.Init(-1, hull == 0 ? model.nodes.Num() : model.clipnodes.Num());
+
+        // Bound the tree by the submodel box, leaves on the outside are open
+        for (int axis = 0; axis < 3; axis++)
+        {
+            FVector3f normal(0.0f, 0.0f, 0.0f);
+            normal[axis] = 1.0f;
+
+            walk.planes.Add({ normal, sm.mins[axis] - margin });
+            walk.planes.Add({ -normal, -(sm.maxs[axis] + margin) });
+        }
+
+        if (hull == 0)
+        {
+            if (headnode >= 0 && headnode < model.nodes.Num())
+            {
+                walk.WalkNode(headnode);
+            }
+        }
+        else if (headnode >= 0 && headnode < model.clipnodes.Num())
+        {
+            walk.WalkClipNode(headnode);
+        }
+    }
+
+    uint64 HashHull(const bspformat29::Bsp_29& model, int submodel, int hull, uint64 seed)
+    {
+        const bspformat29::SubModel& sm = model.submodels[submodel];
+        uint64 hash = CityHash64WithSeed((const char*)sm.mins, sizeof(sm.mins), seed);
+        hash = CityHash64WithSeed((const char*)sm.maxs, sizeof(sm.maxs), hash);
+
+        const int numNodes = hull == 0 ? model.nodes.Num() : model.clipnodes.Num();
+        TArray<int> stack;
+
+        if (sm.headnode[hull] >= 0 && sm.headnode[hull] < numNodes)
+        {
+            stack.Push(sm.headnode[hull]);
+        }
+
+        while (stack.Num())
+        {
+            int node = stack.Pop();
+            int planenum = hull == 0 ? model.nodes[node].planenum : model.clipnodes[node].planenum;
+            const short* children = hull == 0 ? model.nodes[node].children : model.clipnodes[node].children;
+
+            // Normal and dist
+            const bspformat29::Plane& plane = model.planes[planenum];
+            hash = CityHash64WithSeed((const char*)plane.normal, sizeof(plane.normal), hash);
+            hash = CityHash64WithSeed((const char*)&plane.dist, sizeof(plane.dist), hash);
+            hash = CityHash64WithSeed((const char*)children, sizeof(short) * 2, hash);
+
+            for (int side = 0; side < 2; side++)
+            {
+                int child = children[side];
+
+                if (child >= 0)
+                {
+                    if (child < numNodes)
+                    {
+                        stack.Push(child);
+                    }
+
+                    continue;
+                }
+
+                ELeafContentType contents = hull == 0 ? model.leaves[-1 - child].contents : (ELeafContentType)child;
+                hash = CityHash64WithSeed((const char*)&contents, sizeof(contents), hash);
+            }
+        }
+
+        return hash;
+    }
+
+} // namespace bsputils
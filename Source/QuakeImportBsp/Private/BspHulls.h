@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BspUtilities.h"
+
+/*
+============================================
+Bsp hulls
+
+Convex regions of the BSP trees. Every leaf of a tree is the
+intersection of the half spaces along its path from the head node,
+walking the tree and clipping windings by those planes gives the
+corners of each region. Coordinates are in Quake space.
+============================================
+*/
+
+namespace bsputils
+{
+    // Polygon on a plane, clipped down as half spaces are applied
+    typedef TArray<FVector3f> Winding;
+
+    // Quake plane, points in front have DotProduct(normal, p) - dist >= 0
+    struct HullPlane
+    {
+        FVector3f   normal;
+        float       dist;
+    };
+
+    // Corners of one convex region
+    struct HullRegion
+    {
+        TArray<FVector3f>   points;
+        float               volume;
+        ELeafContentType    contents;
+    };
+
+    // Large square on the plane, larger than any map
+    Winding BaseWindingForPlane(const HullPlane& plane);
+
+    // Keep the part of the winding in front of the plane. Empty when nothing is left.
+    Winding ClipWinding(const Winding& in, const HullPlane& plane);
+
+    // Corners and volume of the convex region bounded by planes. False if the region is empty or flat.
+    bool BuildRegion(const TArray<HullPlane>& planes, TArray<FVector3f>& outPoints, float& outVolume);
+
+    // Regions of the submodel hull with the given contents. Hull 0 walks nodes and leaves,
+    // hulls 1 and 2 walk clipnodes. Regions are bounded by the submodel box expanded by margin.
+    // Sibling subtrees holding only those contents are emitted as the single region of their node.
+    void BuildHullRegions(const bspformat29::Bsp_29& model, int submodel, int hull, ELeafContentType contents, float margin, TArray<HullRegion>& out);
+
+    // Hash of everything BuildHullRegions reads for the submodel hull: its box, and the planes
+    // and leaf contents of the node or clipnode tree under its head node
+    uint64 HashHull(const bspformat29::Bsp_29& model, int submodel, int hull, uint64 seed);
+
+} // namespace bsputils
@@ -0,0 +1,242 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BspLightmap.h"
+#include "BspFactory.h"
+#include "BspFaceMerge.h"
+#include "ImportStats.h"
+#include "QuakeImportSettings.h"
+#include "RectPacker.h"
+
+namespace bsputils
+{
+    namespace
+    {
+        // Share of a lightmap page covered by charts, the rest is padding and shelf waste
+        constexpr double PACKING_EFFICIENCY = 0.6;
+
+        // High quality lightmaps, two DXT5 coefficient textures, plus a third for the mip chain
+        constexpr double LIGHTMAP_BYTES_PER_TEXEL = 2.0 * 4.0 / 3.0;
+
+        // Position of a face on its luxel grid
+        struct LuxelChart
+        {
+            FIntPoint           mins;   // first luxel
+            FIntPoint           size;   // luxel count
+            TArray<FVector2f>   coords; // point texture coordinates in luxels
+        };
+
+        LuxelChart BuildChart(const bspformat29::Bsp_29& model, const FacePolygon& polygon, float luxelSize)
+        {
+            const bspformat29::TexInfo& ti = model.texinfos[polygon.texinfo];
+
+            LuxelChart chart;
+            FVector2f mins(MAX_flt, MAX_flt);
+            FVector2f maxs(-MAX_flt, -MAX_flt);
+
+            for (uint32 vertex_id : polygon.points)
+            {
+                const bspformat29::Point3f& p = model.vertices[vertex_id];
+                FVector2f st;
+
+                // Same texture space as the diffuse coordinates, before the division by the texture size
+                st.X = (p.x * ti.vecs[0][0] + p.y * ti.vecs[0][1] + p.z * ti.vecs[0][2] + ti.vecs[0][3]) / luxelSize;
+                st.Y = (p.x * ti.vecs[1][0] + p.y * ti.vecs[1][1] + p.z * ti.vecs[1][2] + ti.vecs[1][3]) / luxelSize;
+
+                chart.coords.Add(st);
+                mins = FVector2f::Min(mins, st);
+                maxs = FVector2f::Max(maxs, st);
+            }
+
+            // CalcSurfaceExtents, floor and ceil to whole luxels, one more luxel than the span
+            chart.mins = FIntPoint(FMath::FloorToInt(mins.X), FMath::FloorToInt(mins.Y));
+            chart.size = FIntPoint(FMath::CeilToInt(maxs.X) - chart.mins.X + 1, FMath::CeilToInt(maxs.Y) - chart.mins.Y + 1);
+
+            return chart;
+        }
+
+        // Area of a chart in texture space texels
+        double ChartArea(const LuxelChart& chart)
+        {
+            double area = 0.0;
+
+            for (int i = 0; i < chart.coords.Num(); i++)
+            {
+                const FVector2f& a = chart.coords[i];
+                const FVector2f& b = chart.coords[(i + 1) % chart.coords.Num()];
+                area += (double)a.X * b.Y - (double)b.X * a.Y;
+            }
+
+            return FMath::Abs(area) * 0.5;
+        }
+    }
+
+    int64 LightmapBytes(int resolution)
+    {
+        return (int64)(LIGHTMAP_BYTES_PER_TEXEL * resolution * resolution);
+    }
+
+    float PolygonArea(const bspformat29::Bsp_29& model, const FacePolygon& polygon)
+    {
+        FVector3f sum(0.0f, 0.0f, 0.0f);
+
+        for (int i = 0; i < polygon.points.Num(); i++)
+        {
+            const bspformat29::Point3f& a = model.vertices[polygon.points[i]];
+            const bspformat29::Point3f& b = model.vertices[polygon.points[(i + 1) % polygon.points.Num()]];
+            sum += FVector3f::CrossProduct(FVector3f(a.x, a.y, a.z), FVector3f(b.x, b.y, b.z));
+        }
+
+        return sum.Size() * 0.5f;
+    }
+
+    int64 ComputeLightmapResolutions(const bspformat29::Bsp_29& model, TArray<int>& out)
+    {
+        QUAKE_IMPORT_SCOPE("ComputeLightmapResolutions");
+
+        const UQuakeImportSettings* settings = GetDefault<UQuakeImportSettings>();
+        const int minResolution = FMath::RoundUpToPowerOfTwo(FMath::Max(4, settings->MinLightmapResolution));
+        const int maxResolution = FMath::Max(minResolution, (int)FMath::RoundUpToPowerOfTwo(FMath::Min(settings->MaxLightmapResolution, MAX_LIGHTMAP_RESOLUTION)));
+        const double texelSize = FMath::Max(1.0f, settings->LightmapTexelSize);
+
+        out.SetNumZeroed(model.submodels.Num());
+        int64 bytes = 0;
+
+        for (int i = 0; i < model.submodels.Num(); i++)
+        {
+            TArray<FacePolygon> polygons;
+            GatherSubmodelPolygons(model, i, polygons);
+
+            if (polygons.Num() == 0)
+            {
+                continue; // no mesh
+            }
+
+            double area = 0.0;
+
+            for (const FacePolygon& polygon : polygons)
+            {
+                if (model.texinfos[polygon.texinfo].flags & bspformat29::TEX_SPECIAL)
+                {
+                    continue; // liquids are unlit
+                }
+
+                area += PolygonArea(model, polygon);
+            }
+
+            double texels = area / (texelSize * texelSize) / PACKING_EFFICIENCY;
+            int resolution = FMath::RoundUpToPowerOfTwo(FMath::Max(1, FMath::CeilToInt(FMath::Sqrt(texels))));
+
+            out[i] = FMath::Clamp(resolution, minResolution, maxResolution);
+            bytes += LightmapBytes(out[i]);
+        }
+
+        // Halve the largest lightmaps until the map fits its budget
+        const int64 budget = (int64)(settings->LightmapBudgetMB * 1024.0 * 1024.0);
+
+        while (budget > 0 && bytes > budget)
+        {
+            int largest = INDEX_NONE;
+
+            for (int i = 0; i < out.Num(); i++)
+            {
+                if (out[i] > minResolution && (largest == INDEX_NONE || out[i] > out[largest]))
+                {
+                    largest = i;
+                }
+            }
+
+            if (largest == INDEX_NONE)
+            {
+                break; // everything at the minimum already
+            }
+
+            bytes -= LightmapBytes(out[largest]) - LightmapBytes(out[largest] / 2);
+            out[largest] /= 2;
+        }
+
+        UE_LOG(LogQuakeImporter, Log, TEXT("Lightmaps: %.2f MB requested for %d submodels, world %dx%d, budget %.2f MB."),
+            bytes / (1024.0 * 1024.0), out.Num(), out.Num() ? out[0] : 0, out.Num() ? out[0] : 0, settings->LightmapBudgetMB);
+
+        return bytes;
+    }
+
+    int PackLightmapUVs(const bspformat29::Bsp_29& model, const TArray<FacePolygon>& polygons, int resolution, TArray<TArray<FVector2f>>& outUVs)
+    {
+        QUAKE_IMPORT_SCOPE("PackLightmapUVs");
+
+        outUVs.SetNum(polygons.Num());
+
+        if (polygons.Num() == 0)
+        {
+            return resolution;
+        }
+
+        // First guess of the luxel size from the texture space area, slightly small so it only grows
+        double area = 0.0;
+
+        for (const FacePolygon& polygon : polygons)
+        {
+            area += ChartArea(BuildChart(model, polygon, 1.0f));
+        }
+
+        float luxelSize = FMath::Max(0.01f, (float)FMath::Sqrt(area / ((double)resolution * resolution * PACKING_EFFICIENCY)));
+
+        while (true)
+        {
+            TArray<LuxelChart> charts;
+            TArray<FIntPoint> sizes;
+            bool smallest = true;
+
+            for (const FacePolygon& polygon : polygons)
+            {
+                LuxelChart& chart = charts.Add_GetRef(BuildChart(model, polygon, luxelSize));
+                sizes.Add(chart.size);
+                smallest &= chart.size.X <= 3 && chart.size.Y <= 3; // span under a luxel, at most across two grid lines
+            }
+
+            RectPacker packer(resolution, 1);
+            TArray<PackedRect> rects;
+            packer.Pack(sizes, rects);
+
+            FIntPoint used = packer.GetPageSize(0);
+
+            if (packer.GetNumPages() > 1 || used.X > resolution || used.Y > resolution)
+            {
+                if (!smallest)
+                {
+                    luxelSize *= 1.1f;
+                    continue;
+                }
+
+                if (resolution < MAX_LIGHTMAP_RESOLUTION)
+                {
+                    // More faces than the page has room for at any luxel size
+                    resolution = FMath::Min(resolution * 2, MAX_LIGHTMAP_RESOLUTION);
+                    continue;
+                }
+
+                // Every chart is at its smallest already, a larger luxel no longer shrinks them
+                UE_LOG(LogQuakeImporter, Warning, TEXT("Lightmap: %d faces do not fit a %dx%d page at any luxel size, their lightmap UVs overlap."),
+                    polygons.Num(), resolution, resolution);
+            }
+
+            for (int i = 0; i < polygons.Num(); i++)
+            {
+                const LuxelChart& chart = charts[i];
+                TArray<FVector2f>& uvs = outUVs[i];
+                uvs.Reset();
+
+                // Luxel n of the face is centered on grid line mins + n
+                for (const FVector2f& st : chart.coords)
+                {
+                    uvs.Add(FVector2f(
+                        (rects[i].x + st.X - chart.mins.X + 0.5f) / resolution,
+                        (rects[i].y + st.Y - chart.mins.Y + 0.5f) / resolution));
+                }
+            }
+
+            return resolution;
+        }
+    }
+
+} // namespace bsputils
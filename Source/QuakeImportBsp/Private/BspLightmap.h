@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BspUtilities.h"
+
+/*
+============================================
+Bsp lightmap
+
+Lightmap resolution and UVs of the submodel meshes.
+
+Every mesh gets a power of two resolution covering its lit surface
+area at the configured texel size. When the meshes of a map add up
+past the lightmap memory budget the largest ones are halved until
+they fit.
+
+Packed UVs are laid out like the Quake lightmap. Each face spans the
+luxel grid of its texinfo, snapped to whole luxels the way the engine
+computes surface extents, and the face rectangles are shelf packed on
+the page. The luxel size is scaled so the page matches the resolution.
+============================================
+*/
+
+namespace bsputils
+{
+    struct FacePolygon;
+
+    // Texels per luxel of the Quake lightmap
+    constexpr float QUAKE_LUXEL_SIZE = 16.0f;
+
+    // Largest lightmap page
+    constexpr int MAX_LIGHTMAP_RESOLUTION = 4096;
+
+    // Memory of a lightmap page
+    int64 LightmapBytes(int resolution);
+
+    // Area of a polygon in Quake units
+    float PolygonArea(const bspformat29::Bsp_29& model, const FacePolygon& polygon);
+
+    // Lightmap resolution of every submodel, within the map budget of the project settings.
+    // Returns the lightmap memory of the requested resolutions in bytes. PackLightmapUVs can
+    // still grow a page, the final resolution is the one of the prepared mesh.
+    int64 ComputeLightmapResolutions(const bspformat29::Bsp_29& model, TArray<int>& out);
+
+    // Lightmap UVs of every polygon point on a page of the requested resolution, outUVs matches polygons.
+    // Returns the page size, larger than requested only when the charts cannot fit at any luxel size,
+    // never past MAX_LIGHTMAP_RESOLUTION.
+    int PackLightmapUVs(const bspformat29::Bsp_29& model, const TArray<FacePolygon>& polygons, int resolution, TArray<TArray<FVector2f>>& outUVs);
+
+} // namespace bsputils
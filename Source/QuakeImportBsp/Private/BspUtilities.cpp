@@ -3,6 +3,15 @@
 // QuakeImport
 #include "BspUtilities.h"
 #include "QuakeCommon.h"
+#include "BspFactory.h"
+#include "BspFaceMerge.h"
+#include "BspHulls.h"
+#include "BspLightmap.h"
+#include "BspVisibility.h"
+#include "ImportCache.h"
+#include "ImportSession.h"
+#include "ImportStats.h"
+#include "QuakeImportSettings.h"
 
 // EPIC
 #include "AssetRegistryModule.h"
@@ -10,9 +19,13 @@
 #include "Editor/EditorEngine.h"
 #include "Engine/StaticMesh.h"
 #include "Engine/Texture2D.h"
+#include "Hash/CityHash.h"
 #include "Factories/MaterialFactoryNew.h"
 #include "Materials/Material.h"
+#include "PhysicsEngine/BodySetup.h"
 #include "RawMesh/Public/RawMesh.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
 #include "UObject/Package.h"
 
 namespace bsputils
@@ -30,6 +43,8 @@ namespace bsputils
 
     void BspLoader::Load(const uint8*& data)
     {
+        QUAKE_IMPORT_SCOPE("ParseBsp");
+
         bspformat29::Header header;
 
         QuakeCommon::ReadData<bspformat29::Header>(data, 0, header);
@@ -50,12 +65,71 @@ namespace bsputils
         DeserializeLump<bspformat29::Marksurface>(data, header.lumps[bspformat29::LUMP_MARKSURFACES], m_bsp29->marksurfaces);
         DeserializeLump<bspformat29::Leaf>(data, header.lumps[bspformat29::LUMP_LEAFS], m_bsp29->leaves);
         DeserializeLump<bspformat29::Node>(data, header.lumps[bspformat29::LUMP_NODES], m_bsp29->nodes);
+        DeserializeLump<bspformat29::ClipNode>(data, header.lumps[bspformat29::LUMP_CLIPNODES], m_bsp29->clipnodes);
         DeserializeLump<bspformat29::SubModel>(data, header.lumps[bspformat29::LUMP_MODELS], m_bsp29->submodels);
         DeserializeLump<bspformat29::TexInfo>(data, header.lumps[bspformat29::LUMP_TEXINFO], m_bsp29->texinfos);
         DeserializeLump<uint8>(data, header.lumps[bspformat29::LUMP_VISIBILITY], m_bsp29->visdata);
 
         LoadTextures(data, header.lumps[bspformat29::LUMP_TEXTURES]);
         LoadEntities(data, header.lumps[bspformat29::LUMP_ENTITIES]);
+
+        if (!ValidateTrees())
+        {
+            delete m_bsp29;
+            m_bsp29 = nullptr;
+        }
+    }
+
+    bool BspLoader::ValidateTrees() const
+    {
+        const int numPlanes = m_bsp29->planes.Num();
+
+        for (int i = 0; i < m_bsp29->nodes.Num(); i++)
+        {
+            const bspformat29::Node& node = m_bsp29->nodes[i];
+
+            if (node.planenum < 0 || node.planenum >= numPlanes)
+            {
+                UE_LOG(LogQuakeImporter, Error, TEXT("BSP Import error: node %d plane %d out of range."), i, node.planenum);
+                return false;
+            }
+
+            for (int side = 0; side < 2; side++)
+            {
+                int child = node.children[side];
+
+                if (child >= 0 ? (child <= i || child >= m_bsp29->nodes.Num()) : (-1 - child >= m_bsp29->leaves.Num()))
+                {
+                    UE_LOG(LogQuakeImporter, Error, TEXT("BSP Import error: node %d child %d out of range."), i, child);
+                    return false;
+                }
+            }
+        }
+
+        for (int i = 0; i < m_bsp29->clipnodes.Num(); i++)
+        {
+            const bspformat29::ClipNode& node = m_bsp29->clipnodes[i];
+
+            if (node.planenum < 0 || node.planenum >= numPlanes)
+            {
+                UE_LOG(LogQuakeImporter, Error, TEXT("BSP Import error: clipnode %d plane %d out of range."), i, node.planenum);
+                return false;
+            }
+
+            for (int side = 0; side < 2; side++)
+            {
+                int child = node.children[side];
+
+                // Negative children are contents
+                if (child >= 0 && (child <= i || child >= m_bsp29->clipnodes.Num()))
+                {
+                    UE_LOG(LogQuakeImporter, Error, TEXT("BSP Import error: clipnode %d child %d out of range."), i, child);
+                    return false;
+                }
+            }
+        }
+
+        return true;
     }
 
     void BspLoader::LoadTextures(const uint8*& data, const bspformat29::Lump& lump)
@@ -92,35 +166,77 @@ namespace bsputils
         m_bsp29->entities = ANSI_TO_TCHAR(in);
     }
 
-    void AddWedgeEntry(FRawMesh& mesh, const uint32 index, const FVector3f normal, const FVector2f texcoord0, const FVector2f texcoord1)
+    bool ReadTextureNames(const uint8* data, int64 size, TArray<FString>& out)
+    {
+        if (size < (int64)sizeof(bspformat29::Header))
+        {
+            return false;
+        }
+
+        bspformat29::Header header;
+        QuakeCommon::ReadData<bspformat29::Header>(data, 0, header);
+
+        const bspformat29::Lump& lump = header.lumps[bspformat29::LUMP_TEXTURES];
+
+        if (header.version != bspformat29::HEADER_VERSION_29 || lump.position < 0 || lump.position + (int64)sizeof(int) > size)
+        {
+            return false;
+        }
+
+        int numtex = 0;
+        QuakeCommon::ReadData(data, lump.position, numtex);
+
+        for (int i = 0; i < numtex; i++)
+        {
+            int offset = 0;
+            int64 position = lump.position + sizeof(int) * (i + 1);
+
+            if (position + (int64)sizeof(int) > size)
+            {
+                return false;
+            }
+
+            QuakeCommon::ReadData(data, (int)position, offset);
+
+            if (offset < 0 || lump.position + (int64)offset + sizeof(bspformat29::Miptex) > size)
+            {
+                continue; // -1 offsets mark missing textures
+            }
+
+            const bspformat29::Miptex* mt = reinterpret_cast<const bspformat29::Miptex*>(data + lump.position + offset);
+
+            char name[sizeof(mt->name) + 1] = {};
+            FMemory::Memcpy(name, mt->name, sizeof(mt->name));
+            out.Add(ANSI_TO_TCHAR(name));
+        }
+
+        return true;
+    }
+
+    void AddWedgeEntry(FRawMesh& mesh, const uint32 index, const FVector3f normal, const FVector2f texcoord0, const FVector2f* texcoord1)
     {
         mesh.WedgeIndices.Add(index);
         mesh.WedgeColors.Add(FColor(0));
         mesh.WedgeTangentZ.Add(normal);
         mesh.WedgeTexCoords[0].Add(texcoord0);
+
+        if (texcoord1)
+        {
+            mesh.WedgeTexCoords[1].Add(*texcoord1);
+        }
     }
 
-    void CreateSubmodel(UPackage& package, const uint8 id, const bspformat29::Bsp_29& model, const UPackage& materialPackage)
+    void GatherSubmodelPolygons(const bspformat29::Bsp_29& model, const int id, TArray<FacePolygon>& out, int* outSourceTris)
     {
-        using namespace bsputils;
+        const bool removeHidden = GetDefault<UQuakeImportSettings>()->bRemoveHiddenSurfaces;
+        TBitArray<> visibleFaces;
 
-        struct Triface
+        if (removeHidden && id == 0)
         {
-            int numtris = 0;
-            FVector normal;
-            TArray<uint32> points;
-            int texinfo;
-            TArray<FVector2f> texcoords;
-        };
-
-        FString submodelName("submodel");
-        submodelName += "_";
-        submodelName += FString::FromInt(id);
-
-        UStaticMesh* staticmesh = NewObject<UStaticMesh>(&package, FName(*submodelName), RF_Public | RF_Standalone);
-        staticmesh->AddToRoot();
+            FindVisibleFaces(model, visibleFaces);
+        }
 
-        TArray<Triface> faces;
+        int totalTris = 0;
 
         for (
             int f = model.submodels[id].firstface;
@@ -139,15 +255,18 @@ namespace bsputils
                 continue;
             }
 
-            Triface triface;
-            triface.texinfo = face.texinfo;
-            triface.numtris = face.numedges - 2; // make up number of this needed for this face 
+            totalTris += face.numedges - 2;
 
-            for (int i = 0; i < 3; i++)
+            if (removeHidden && (IsToolTexture(tex.name) || (visibleFaces.Num() > 0 && !visibleFaces[f])))
             {
-                triface.normal[i] = model.planes[face.planenum].normal[i];
+                continue;
             }
 
+            FacePolygon polygon;
+            polygon.planenum = face.planenum;
+            polygon.side = face.side;
+            polygon.texinfo = face.texinfo;
+
             for (int e = face.numedges; e-- > 0;) // extract all vertex
             { 
                 const bspformat29::Surfedge& surfedge = model.surfedges[face.firstedge + e];
@@ -160,8 +279,93 @@ namespace bsputils
                     vertex_id = edge.second;
                 }
 
-                triface.points.Add(vertex_id);
+                polygon.points.Add(vertex_id);
+            }
+
+            out.Add(polygon);
+        }
+
+        if (outSourceTris)
+        {
+            *outSourceTris = totalTris;
+        }
+    }
+
+    void BuildSubmodelRawMesh(const bspformat29::Bsp_29& model, const int id, const int lightmapResolution, FRawMesh& out, TArray<FString>& outMaterials, int& outLightmapResolution)
+    {
+        QUAKE_IMPORT_SCOPE("TriangulateSubmodel");
+
+        struct Triface
+        {
+            FVector normal;
+            TArray<uint32> points;
+            int texinfo;
+            TArray<FVector2f> texcoords;
+            TArray<int32> corners; // triangles as indices into points
+            TArray<FVector2f> lightmapcoords;
+        };
+
+        TArray<FacePolygon> polygons;
+        int totalTris = 0;
+        GatherSubmodelPolygons(model, id, polygons, &totalTris);
+
+        int keptTris = 0;
+
+        for (const FacePolygon& polygon : polygons)
+        {
+            keptTris += polygon.points.Num() - 2;
+        }
+
+        if (GetDefault<UQuakeImportSettings>()->bRemoveHiddenSurfaces && totalTris > 0)
+        {
+            UE_LOG(LogQuakeImporter, Log, TEXT("submodel_%d: hidden surface removal kept %d of %d triangles (%.1f%% removed)."),
+                id, keptTris, totalTris, 100.0f * (totalTris - keptTris) / totalTris);
+        }
 
+        if (GetDefault<UQuakeImportSettings>()->bMergeCoplanarFaces)
+        {
+            const int facesBefore = polygons.Num();
+            MergeCoplanarFaces(model, polygons);
+
+            int mergedTris = 0;
+
+            for (const FacePolygon& polygon : polygons)
+            {
+                mergedTris += polygon.points.Num() - 2;
+            }
+
+            UE_LOG(LogQuakeImporter, Log, TEXT("submodel_%d: coplanar merge, %d faces to %d, %d triangles to %d."),
+                id, facesBefore, polygons.Num(), keptTris, mergedTris);
+        }
+
+        // Lightmap UVs straight from the luxel grid rather than unwrapped at build time. Packing may need a larger page.
+        TArray<TArray<FVector2f>> lightmapUVs;
+        outLightmapResolution = lightmapResolution;
+
+        if (GetDefault<UQuakeImportSettings>()->LightmapUVs == EBspLightmapUVs::QuakeLuxels)
+        {
+            outLightmapResolution = PackLightmapUVs(model, polygons, lightmapResolution, lightmapUVs);
+        }
+
+        TArray<Triface> faces;
+
+        for (int p = 0; p < polygons.Num(); p++)
+        {
+            const FacePolygon& polygon = polygons[p];
+            const bspformat29::TexInfo& ti = model.texinfos[polygon.texinfo];
+            const bspformat29::Texture& tex = model.textures[ti.miptex];
+
+            Triface triface;
+            triface.texinfo = polygon.texinfo;
+            triface.points = polygon.points;
+
+            for (int i = 0; i < 3; i++)
+            {
+                triface.normal[i] = model.planes[polygon.planenum].normal[i];
+            }
+
+            for (uint32 vertex_id : polygon.points)
+            {
                 FVector2f tex_coord;
 
                 // Generate texture coordinates
@@ -181,10 +385,17 @@ namespace bsputils
                 triface.texcoords.Add(tex_coord);
             }
 
+            if (lightmapUVs.Num())
+            {
+                triface.lightmapcoords = MoveTemp(lightmapUVs[p]);
+            }
+
+            TriangulatePolygon(model, triface.points, triface.corners);
+
             faces.Add(triface);
         }
 
-        FRawMesh* rmesh = new FRawMesh();
+        FRawMesh& rmesh = out;
 
         // Vertices
         for (int i = 0; i < model.vertices.Num(); i++)
@@ -194,96 +405,307 @@ namespace bsputils
                 model.vertices[i].y,
                 model.vertices[i].z);
 
-            rmesh->VertexPositions.Add(vec);
+            rmesh.VertexPositions.Add(vec);
         }
 
         // tris
 
         for (int i = 0; i < faces.Num(); i++)
         {
-            for (int j = 0; j < faces[i].numtris; j++)
+            for (int j = 0; j + 2 < faces[i].corners.Num(); j += 3)
             {
-                AddWedgeEntry(
-                    *rmesh,
-                    faces[i].points[0],
-                    FVector3f(faces[i].normal.X, faces[i].normal.Y, faces[i].normal.Z),
-                    faces[i].texcoords[0],
-                    faces[i].texcoords[0]
-                );
-
-                for (int c = 1; c < 3; c++)
+                for (int c = 0; c < 3; c++)
                 {
-                    int index = j + c;
+                    int index = faces[i].corners[j + c];
 
                     AddWedgeEntry(
-                        *rmesh,
+                        rmesh,
                         faces[i].points[index],
                         FVector3f(faces[i].normal.X, faces[i].normal.Y, faces[i].normal.Z),
                         faces[i].texcoords[index],
-                        faces[i].texcoords[index]
+                        faces[i].lightmapcoords.Num() ? &faces[i].lightmapcoords[index] : nullptr
                     );
                 }
 
                 int32 materialId = model.texinfos[faces[i].texinfo].miptex;
 
-                UMaterialInterface* material = (UMaterialInterface*)QuakeCommon::CheckIfAssetExist<UMaterialInterface>(model.textures[materialId].name, materialPackage);
+                rmesh.FaceMaterialIndices.Add(outMaterials.AddUnique(model.textures[materialId].name));
+                rmesh.FaceSmoothingMasks.Add(0); // TODO dont know how that work yet
+            }
+        }
+    }
 
-                if (!material)
-                {
-                    material = UMaterial::GetDefaultMaterial(MD_Surface);
-                }
+    void PrepareSubmodelMesh(const bspformat29::Bsp_29& model, const int id, const int lightmapResolution, SubmodelMeshData& out)
+    {
+        QUAKE_IMPORT_SCOPE("PrepareSubmodelMesh");
 
-                int32 MaterialIndex = staticmesh->GetStaticMaterials().AddUnique(
-                    FStaticMaterial(
-                        material,
-                        FName(*model.textures[materialId].name),
-                        FName(*model.textures[materialId].name)
-                    )
-                );
+        out.id = id;
+        out.hash = SubmodelImportHash(model, id, lightmapResolution);
+        out.lightmapResolution = lightmapResolution;
+
+        // Triangulated faces, from the import cache when this face set was converted before
+        FString cacheKey = QuakeCommon::MakeCacheKey(TEXT("bspmesh"), HashSubmodel(model, id), FString::Printf(TEXT("lightmap=%d"), lightmapResolution));
+        TArray<uint8> cached;
+        bool cacheHit = false;
+
+        if (QuakeCommon::LoadCachedData(cacheKey, cached))
+        {
+            FMemoryReader reader(cached);
+            reader << out.rawMesh << out.materials << out.lightmapResolution;
+            cacheHit = !reader.IsError() && out.rawMesh.IsValid();
+        }
+
+        if (!cacheHit)
+        {
+            out.rawMesh = FRawMesh();
+            out.materials.Empty();
+            BuildSubmodelRawMesh(model, id, lightmapResolution, out.rawMesh, out.materials, out.lightmapResolution);
+
+            TArray<uint8> data;
+            FMemoryWriter writer(data);
+            writer << out.rawMesh << out.materials << out.lightmapResolution;
+            QuakeCommon::StoreCachedData(cacheKey, data);
+        }
+
+        // Convex solids of the clip hull replacing the simple collision of the mesh
+        out.collisionHull = INDEX_NONE;
+        out.collision.Empty();
 
-                rmesh->FaceMaterialIndices.Add(MaterialIndex);
-                rmesh->FaceSmoothingMasks.Add(0); // TODO dont know how that work yet
+        const UQuakeImportSettings* settings = GetDefault<UQuakeImportSettings>();
+
+        if (settings->Collision != EBspCollision::RenderMesh && out.rawMesh.WedgeIndices.Num() > 0)
+        {
+            int hull = settings->Collision == EBspCollision::Hull1 ? 1 : 0;
+
+            TArray<HullRegion> regions;
+            BuildHullRegions(model, id, hull, ELeafContentType::Solid, hull == 0 ? 1.0f : 32.0f, regions);
+
+            if (regions.Num() > settings->MaxCollisionElements)
+            {
+                UE_LOG(LogQuakeImporter, Warning, TEXT("submodel_%d: hull %d needs %d convex elements, over the limit of %d. Using the render mesh collision."),
+                    id, hull, regions.Num(), settings->MaxCollisionElements);
+                return;
+            }
+
+            out.collisionHull = hull;
+
+            for (HullRegion& region : regions)
+            {
+                out.collision.Add(MoveTemp(region.points));
             }
         }
+    }
 
-        FStaticMeshSourceModel* srcModel = &staticmesh->AddSourceModel();
+    // Replace the simple collision of the submodel mesh with the convex solids of its clip hull
+    void CreateHullCollision(UStaticMesh& staticmesh, const SubmodelMeshData& data)
+    {
+        if (data.collisionHull == INDEX_NONE)
+        {
+            // Drop hull collision left by a previous import with another setting
+            if (UBodySetup* bodySetup = staticmesh.GetBodySetup())
+            {
+                bodySetup->RemoveSimpleCollision();
+                bodySetup->CollisionTraceFlag = CTF_UseDefault;
+            }
 
-        int lightmapSize = 32;
+            return;
+        }
 
-        if (id == 0)
+        staticmesh.CreateBodySetup();
+        UBodySetup* bodySetup = staticmesh.GetBodySetup();
+        bodySetup->Modify();
+        bodySetup->RemoveSimpleCollision();
+
+        for (const TArray<FVector3f>& points : data.collision)
         {
-            lightmapSize = 512; // main model mesh
+            FKConvexElem elem;
+
+            for (const FVector3f& point : points)
+            {
+                elem.VertexData.Add(FVector(-point.X, point.Y, point.Z)); // flip X axis
+            }
+
+            elem.UpdateElemBox();
+            bodySetup->AggGeom.ConvexElems.Add(elem);
         }
 
+        // Hull 0 is the visible geometry, queries can use it. Hull 1 is expanded by the player box,
+        // only movement collides with it and traces keep hitting the render triangles.
+        bodySetup->CollisionTraceFlag = data.collisionHull == 0 ? CTF_UseSimpleAsComplex : CTF_UseDefault;
+        bodySetup->InvalidatePhysicsData();
+        bodySetup->CreatePhysicsMeshes();
+
+        UE_LOG(LogQuakeImporter, Log, TEXT("submodel_%d: %d convex collision elements from hull %d."), data.id, data.collision.Num(), data.collisionHull);
+    }
+
+    UStaticMesh* CreateSubmodel(UPackage& package, const SubmodelMeshData& data, QuakeCommon::ImportPackages& materialPackages)
+    {
+        check(IsInGameThread());
+
+        FString submodelName("submodel");
+        submodelName += "_";
+        submodelName += FString::FromInt(data.id);
+
+        if (data.rawMesh.WedgeIndices.Num() == 0)
+        {
+            // Only sky or tool textured faces, nothing to render
+            UE_LOG(LogQuakeImporter, Log, TEXT("%s: no visible faces, mesh skipped."), *submodelName);
+            return nullptr;
+        }
+
+        UStaticMesh* staticmesh = FindObject<UStaticMesh>(&package, *submodelName);
+
+        if (staticmesh)
+        {
+            // Reimport, rebuild the existing mesh in place so actors keep referencing it
+            staticmesh->GetStaticMaterials().Empty();
+            staticmesh->SetNumSourceModels(0);
+        }
+        else
+        {
+            staticmesh = NewObject<UStaticMesh>(&package, FName(*submodelName), RF_Public | RF_Standalone);
+            QuakeCommon::ImportSession::Root(*staticmesh);
+        }
+
+        // One material lookup per texture rather than per triangle
+        TArray<int32> slots;
+
+        for (const FString& name : data.materials)
+        {
+            UMaterialInterface* material = (UMaterialInterface*)QuakeCommon::CheckIfAssetExist<UMaterialInterface>(name, materialPackages.ForAsset(name));
+
+            if (!material)
+            {
+                material = UMaterial::GetDefaultMaterial(MD_Surface);
+            }
+
+            slots.Add(staticmesh->GetStaticMaterials().AddUnique(FStaticMaterial(material, FName(*name), FName(*name))));
+        }
+
+        FRawMesh rmesh = data.rawMesh;
+
+        for (int32& index : rmesh.FaceMaterialIndices)
+        {
+            index = slots[index];
+        }
+
+        FStaticMeshSourceModel* srcModel = &staticmesh->AddSourceModel();
+
+        // Packed luxel UVs already sit on the lightmap texel grid
+        const bool packedLightmap = rmesh.WedgeTexCoords[1].Num() > 0;
+        const int lightmapSize = data.lightmapResolution;
+
         srcModel->BuildSettings.MinLightmapResolution = lightmapSize;
-        srcModel->BuildSettings.SrcLightmapIndex = 0;
+        srcModel->BuildSettings.SrcLightmapIndex = packedLightmap ? 1 : 0;
         srcModel->BuildSettings.DstLightmapIndex = 1;
-        srcModel->BuildSettings.bGenerateLightmapUVs = true;
+        srcModel->BuildSettings.bGenerateLightmapUVs = !packedLightmap;
         srcModel->BuildSettings.bUseFullPrecisionUVs = true;
-        srcModel->RawMeshBulkData->SaveRawMesh(*rmesh);
+        srcModel->RawMeshBulkData->SaveRawMesh(rmesh);
 
         staticmesh->SetLightingGuid();
         staticmesh->ImportVersion = EImportStaticMeshVersion::LastVersion;
         //staticmesh->CreateBodySetup();
         staticmesh->SetLightingGuid();
         staticmesh->EnforceLightmapRestrictions(); // Make sure the Lightmap UV point on a valid UVChannel
-        staticmesh->Build();
+
+        {
+            QUAKE_IMPORT_SCOPE("BuildStaticMesh");
+            staticmesh->Build();
+        }
+
         staticmesh->SetLightingGuid();
         staticmesh->LightMapResolution = lightmapSize;
         staticmesh->LightMapCoordinateIndex = 1;
+
+        CreateHullCollision(*staticmesh, data);
+
         staticmesh->PostEditChange();
 
+        QuakeCommon::SetImportHash(*staticmesh, data.hash);
         package.MarkPackageDirty();
 
-        delete rmesh;
+        return staticmesh;
     }
 
-    void ModelToStaticmeshes(const bspformat29::Bsp_29& model, UPackage& package, const UPackage& materialPackage)
+    uint64 HashSubmodel(const bspformat29::Bsp_29& model, const int id)
     {
-        for (int i = 0; i < model.submodels.Num(); i++)
+        QUAKE_IMPORT_SCOPE("HashSubmodel");
+
+        const bspformat29::SubModel& submodel = model.submodels[id];
+        uint64 hash = CityHash64((const char*)&submodel.numfaces, sizeof(submodel.numfaces));
+
+        // Hidden surface removal depends on the leaves, their faces and the PVS
+        const bool removeHidden = GetDefault<UQuakeImportSettings>()->bRemoveHiddenSurfaces;
+        hash = CityHash64WithSeed((const char*)&removeHidden, sizeof(removeHidden), hash);
+
+        if (removeHidden && id == 0)
         {
-            CreateSubmodel(package, i, model, materialPackage);
+            hash = CityHash64WithSeed((const char*)model.leaves.GetData(), model.leaves.Num() * sizeof(bspformat29::Leaf), hash);
+            hash = CityHash64WithSeed((const char*)model.marksurfaces.GetData(), model.marksurfaces.Num() * sizeof(bspformat29::Marksurface), hash);
+            hash = CityHash64WithSeed((const char*)model.visdata.GetData(), model.visdata.Num(), hash);
+
+            // Entities only through the leaves they seed the flood from, moving a light within its leaf keeps the mesh
+            TArray<int> seeds;
+            FindSeedLeaves(model, seeds);
+            hash = CityHash64WithSeed((const char*)seeds.GetData(), seeds.Num() * sizeof(int), hash);
         }
+
+        const bool mergeFaces = GetDefault<UQuakeImportSettings>()->bMergeCoplanarFaces;
+        hash = CityHash64WithSeed((const char*)&mergeFaces, sizeof(mergeFaces), hash);
+
+        const EBspLightmapUVs lightmapUVs = GetDefault<UQuakeImportSettings>()->LightmapUVs;
+        hash = CityHash64WithSeed((const char*)&lightmapUVs, sizeof(lightmapUVs), hash);
+
+        for (int f = submodel.firstface; f < (submodel.numfaces + submodel.firstface); f++)
+        {
+            const bspformat29::Face& face = model.faces[f];
+            const bspformat29::TexInfo& ti = model.texinfos[face.texinfo];
+            const bspformat29::Texture& tex = model.textures[ti.miptex];
+
+            hash = CityHash64WithSeed((const char*)model.planes[face.planenum].normal, sizeof(float) * 3, hash);
+            hash = CityHash64WithSeed((const char*)&model.planes[face.planenum].dist, sizeof(float), hash);
+            hash = CityHash64WithSeed((const char*)&face.side, sizeof(face.side), hash);
+            hash = CityHash64WithSeed((const char*)ti.vecs, sizeof(ti.vecs), hash);
+            hash = CityHash64WithSeed((const char*)*tex.name, tex.name.Len() * sizeof(TCHAR), hash);
+            hash = CityHash64WithSeed((const char*)&tex.width, sizeof(tex.width), hash);
+            hash = CityHash64WithSeed((const char*)&tex.height, sizeof(tex.height), hash);
+
+            for (int e = 0; e < face.numedges; e++)
+            {
+                const bspformat29::Surfedge& surfedge = model.surfedges[face.firstedge + e];
+                const bspformat29::Edge& edge = model.edges[FMath::Abs(surfedge.index)];
+                const int vertex_id = surfedge.index < 0 ? edge.second : edge.first;
+
+                hash = CityHash64WithSeed((const char*)&model.vertices[vertex_id], sizeof(bspformat29::Point3f), hash);
+            }
+        }
+
+        return hash;
+    }
+
+    uint64 SubmodelImportHash(const bspformat29::Bsp_29& model, const int id, const int lightmapResolution)
+    {
+        // The collision setting and lightmap resolution change the mesh too
+        const UQuakeImportSettings* settings = GetDefault<UQuakeImportSettings>();
+        const EBspCollision collision = settings->Collision;
+        uint64 hash = CityHash64WithSeed((const char*)&collision, sizeof(collision), HashSubmodel(model, id));
+
+        // Hull collision is built from the node or clipnode tree, not from the faces
+        if (collision != EBspCollision::RenderMesh)
+        {
+            hash = CityHash64WithSeed((const char*)&settings->MaxCollisionElements, sizeof(settings->MaxCollisionElements), hash);
+            hash = HashHull(model, id, collision == EBspCollision::Hull1 ? 1 : 0, hash);
+        }
+
+        return CityHash64WithSeed((const char*)&lightmapResolution, sizeof(lightmapResolution), hash);
+    }
+
+    bool IsSubmodelCurrent(UPackage& package, const int id, const uint64 hash)
+    {
+        FString submodelName = FString("submodel_") + FString::FromInt(id);
+        UObject* existing = QuakeCommon::CheckIfAssetExist<UStaticMesh>(submodelName, package);
+
+        return existing && QuakeCommon::IsImportHashCurrent(*existing, hash);
     }
 
     bool AppendNextTextureData(const FString& name, const int frame, const bspformat29::Bsp_29& model, TArray<uint8>& data)
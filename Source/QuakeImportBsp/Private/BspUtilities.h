@@ -4,12 +4,16 @@
 
 #include "CoreMinimal.h"
 #include "QuakeCommon.h"
+#include "RawMesh/Public/RawMesh.h"
 
 class UTexture2D;
 class UPackage;
+class UStaticMesh;
 
 namespace bsputils
 {
+    struct FacePolygon;
+
     enum class ELeafContentType
     {
         Empty = -1,
@@ -49,6 +53,8 @@ namespace bsputils
         constexpr int MAXLIGHTMAPS = 4;
         constexpr int MAXLEAVES = 8192;
 
+        constexpr int TEX_SPECIAL = 1;          // texinfo flag of sky and liquid surfaces, they have no lightmap
+
         struct QColor
         {
             uint8 r;
@@ -141,6 +147,12 @@ namespace bsputils
             unsigned short	numfaces;
         };
 
+        struct ClipNode
+        {
+            int     planenum;
+            short   children[2]; // negative numbers are contents
+        };
+
         struct SubModel
         {
             float   mins[3];
@@ -186,6 +198,7 @@ namespace bsputils
             TArray<Marksurface> marksurfaces;
             TArray<Leaf>        leaves;
             TArray<Node>        nodes;
+            TArray<ClipNode>    clipnodes;
             TArray<SubModel>    submodels;
             TArray<TexInfo>     texinfos;
             TArray<Texture>     textures;
@@ -214,6 +227,9 @@ namespace bsputils
 
         void LoadTextures(const uint8*& data, const bspformat29::Lump& lump);
         void LoadEntities(const uint8*& data, const bspformat29::Lump& lump);
+
+        // Node and clipnode children in range, and after their parent like qbsp writes them so the trees have no cycles
+        bool ValidateTrees() const;
     };
 
     template<typename T>
@@ -232,10 +248,50 @@ namespace bsputils
         return true;
     }
 
+    // Shared texture and material packages of every imported map
+    constexpr const TCHAR* TEXTURE_PACKAGE_NAME = TEXT("/Game/Textures/Textures");
+    constexpr const TCHAR* MATERIAL_PACKAGE_NAME = TEXT("/Game/Textures/Materials");
+
+    // Names of the miptex in a bsp file, without loading anything else. False if not a version 29 bsp.
+    bool ReadTextureNames(const uint8* data, int64 size, TArray<FString>& out);
+
     // UNREALED Import functions
     
-    // From a Quake BSP model, import all submodels to individual staticmeshes
-    void ModelToStaticmeshes(const bspformat29::Bsp_29& model, UPackage& package, const UPackage& materialPackage);
+    // Hash of everything a submodel mesh is built from: face geometry, texinfo and texture names
+    uint64 HashSubmodel(const bspformat29::Bsp_29& model, const int id);
+
+    // Faces of the submodel that get rendered: no sky and, with hidden surface removal, no tool textures or hidden faces.
+    // outSourceTris receives the triangle count before removal.
+    void GatherSubmodelPolygons(const bspformat29::Bsp_29& model, const int id, TArray<FacePolygon>& out, int* outSourceTris = nullptr);
+
+    // Triangulate the submodel faces. FaceMaterialIndices index outMaterials, the texture names in first use order.
+    // outLightmapResolution is lightmapResolution, or the larger page the packed luxel UVs needed.
+    void BuildSubmodelRawMesh(const bspformat29::Bsp_29& model, const int id, const int lightmapResolution, FRawMesh& out, TArray<FString>& outMaterials, int& outLightmapResolution);
+
+    // Everything needed to create a submodel static mesh, prepared without touching any UObject
+    struct SubmodelMeshData
+    {
+        int                         id = 0;
+        uint64                      hash = 0;               // import hash stored on the mesh
+        FRawMesh                    rawMesh;                // FaceMaterialIndices index materials
+        TArray<FString>             materials;
+        int                         lightmapResolution = 0;
+        int                         collisionHull = INDEX_NONE; // none for render mesh collision
+        TArray<TArray<FVector3f>>   collision;              // convex hull corners in Quake space
+    };
+
+    // Hash of a submodel mesh with the settings it is built with. Equal hashes skip the rebuild.
+    uint64 SubmodelImportHash(const bspformat29::Bsp_29& model, const int id, const int lightmapResolution);
+
+    // True when the submodel mesh in the package was imported with this hash
+    bool IsSubmodelCurrent(UPackage& package, const int id, const uint64 hash);
+
+    // Triangles, materials and collision of a submodel, from the import cache when possible. Safe on any thread.
+    void PrepareSubmodelMesh(const bspformat29::Bsp_29& model, const int id, const int lightmapResolution, SubmodelMeshData& out);
+
+    // Create or rebuild in place the static mesh of a prepared submodel. Game thread only.
+    // Returns nullptr for submodels with nothing to render.
+    UStaticMesh* CreateSubmodel(UPackage& package, const SubmodelMeshData& data, QuakeCommon::ImportPackages& materialPackages);
 
     // Append texture pixel data to array
     bool AppendNextTextureData(const FString& name, const int frame, const bspformat29::Bsp_29& model, TArray<uint8>& data);
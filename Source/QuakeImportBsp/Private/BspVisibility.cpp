@@ -0,0 +1,193 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BspVisibility.h"
+#include "EntityMaker.h"
+#include "ImportStats.h"
+
+namespace bsputils
+{
+    int PointInLeaf(const bspformat29::Bsp_29& model, const FVector3f& point)
+    {
+        int node = model.submodels.Num() > 0 ? model.submodels[0].headnode[0] : -1;
+
+        while (node >= 0 && node < model.nodes.Num())
+        {
+            const bspformat29::Node& n = model.nodes[node];
+            const bspformat29::Plane& plane = model.planes[n.planenum];
+            float d = point.X * plane.normal[0] + point.Y * plane.normal[1] + point.Z * plane.normal[2] - plane.dist;
+
+            node = n.children[d >= 0.0f ? 0 : 1];
+        }
+
+        return -1 - node; // leaves are stored as -(leaf + 1)
+    }
+
+    bool DecompressVis(const bspformat29::Bsp_29& model, int leaf, TBitArray<>& out)
+    {
+        out.Init(false, model.leaves.Num());
+
+        if (model.visdata.Num() == 0 || model.submodels.Num() == 0 || !model.leaves.IsValidIndex(leaf))
+        {
+            return false;
+        }
+
+        int visofs = model.leaves[leaf].visofs;
+
+        if (visofs < 0 || visofs >= model.visdata.Num())
+        {
+            return false;
+        }
+
+        // Leaf 0 is the shared solid leaf, bit n is leaf n + 1. Runs of zero bytes are stored as a 0 and a count.
+        const int visleafs = FMath::Min(model.submodels[0].visleafs, model.leaves.Num() - 1);
+        const uint8* in = model.visdata.GetData() + visofs;
+        const uint8* end = model.visdata.GetData() + model.visdata.Num();
+        int bit = 0;
+
+        while (bit < visleafs && in < end)
+        {
+            if (*in)
+            {
+                for (int i = 0; i < 8 && bit + i < visleafs; i++)
+                {
+                    if (*in & (1 << i))
+                    {
+                        out[bit + i + 1] = true;
+                    }
+                }
+
+                bit += 8;
+                in++;
+            }
+            else if (in + 1 < end)
+            {
+                bit += in[1] * 8;
+                in += 2;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    void FindSeedLeaves(const bspformat29::Bsp_29& model, TArray<int>& out)
+    {
+        out.Reset();
+
+        if (model.submodels.Num() == 0)
+        {
+            return;
+        }
+
+        const int visleafs = FMath::Min(model.submodels[0].visleafs, model.leaves.Num() - 1);
+
+        TArray<AttributeGroup> entities;
+        DeserializeGroup(model.entities, entities);
+
+        for (const AttributeGroup& entity : entities)
+        {
+            const Attribute* origin = entity.Get(TEXT("origin"));
+
+            if (!origin)
+            {
+                continue;
+            }
+
+            FVector position = origin->ToVector3f();
+            int leaf = PointInLeaf(model, FVector3f(-position.X, position.Y, position.Z)); // back to Quake space
+
+            if (leaf > 0 && leaf <= visleafs && model.leaves[leaf].contents != ELeafContentType::Solid)
+            {
+                out.AddUnique(leaf);
+            }
+        }
+
+        out.Sort();
+    }
+
+    void FindVisibleFaces(const bspformat29::Bsp_29& model, TBitArray<>& out)
+    {
+        QUAKE_IMPORT_SCOPE("FindVisibleFaces");
+
+        out.Init(false, model.faces.Num());
+
+        if (model.submodels.Num() == 0)
+        {
+            return;
+        }
+
+        const int visleafs = FMath::Min(model.submodels[0].visleafs, model.leaves.Num() - 1);
+
+        // Seed the flood with the leaves players, monsters and items start in
+        TBitArray<> reached(false, model.leaves.Num());
+        TArray<int> pending;
+        FindSeedLeaves(model, pending);
+
+        for (int leaf : pending)
+        {
+            reached[leaf] = true;
+        }
+
+        bool hasVis = pending.Num() > 0;
+        TBitArray<> visible;
+
+        while (hasVis && pending.Num() > 0)
+        {
+            int leaf = pending.Pop();
+
+            if (!DecompressVis(model, leaf, visible))
+            {
+                hasVis = false;
+                break;
+            }
+
+            for (TConstSetBitIterator<> it(visible); it; ++it)
+            {
+                if (!reached[it.GetIndex()])
+                {
+                    reached[it.GetIndex()] = true;
+                    pending.Add(it.GetIndex());
+                }
+            }
+        }
+
+        for (int leaf = 1; leaf <= visleafs; leaf++)
+        {
+            const bspformat29::Leaf& l = model.leaves[leaf];
+
+            if (l.contents == ELeafContentType::Solid || (hasVis && !reached[leaf]))
+            {
+                continue;
+            }
+
+            for (int m = l.firstmarksurface; m < l.firstmarksurface + l.nummarksurfaces && m < model.marksurfaces.Num(); m++)
+            {
+                int face = (unsigned short)model.marksurfaces[m].index;
+
+                if (face < model.faces.Num())
+                {
+                    out[face] = true;
+                }
+            }
+        }
+    }
+
+    bool IsToolTexture(const FString& name)
+    {
+        static const TCHAR* toolTextures[] = { TEXT("trigger"), TEXT("clip"), TEXT("hint"), TEXT("hintskip"), TEXT("skip"), TEXT("origin") };
+
+        for (const TCHAR* tool : toolTextures)
+        {
+            if (name.Equals(tool, ESearchCase::IgnoreCase))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+} // namespace bsputils
@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BspUtilities.h"
+
+/*
+============================================
+Bsp visibility
+
+Which world faces can be seen by a player. Every face is referenced by
+the marksurfaces of the leaves it borders. Faces only bordering solid
+leaves, or leaves the player can never reach, are hidden. Reachable
+leaves are found by flooding the PVS from the leaves holding entity
+origins. Maps compiled without vis keep every non solid leaf.
+============================================
+*/
+
+namespace bsputils
+{
+    // Leaf of the world hull 0 tree containing a point in Quake space
+    int PointInLeaf(const bspformat29::Bsp_29& model, const FVector3f& point);
+
+    // Leaves visible from a leaf, indexed like model.leaves. False when the map has no vis data.
+    bool DecompressVis(const bspformat29::Bsp_29& model, int leaf, TBitArray<>& out);
+
+    // Sorted leaves holding entity origins, where the flood starts. Entities only matter through these.
+    void FindSeedLeaves(const bspformat29::Bsp_29& model, TArray<int>& out);
+
+    // Faces referenced by reachable non solid leaves of the world, indexed like model.faces
+    void FindVisibleFaces(const bspformat29::Bsp_29& model, TBitArray<>& out);
+
+    // Compiler tool textures, never rendered in game
+    bool IsToolTexture(const FString& name);
+
+} // namespace bsputils
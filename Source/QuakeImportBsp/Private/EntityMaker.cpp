@@ -5,6 +5,7 @@
 #include "Containers/StringConv.h"
 #include "Engine/Light.h"
 #include "Engine/World.h"
+#include "GameFramework/WorldSettings.h"
 
 #include "Engine/PointLight.h"
 #include "Engine/StaticMeshActor.h"
@@ -14,6 +15,10 @@
 #include "UObject/UObjectGlobals.h"
 #include "FileHelpers.h"
 #include "Components/PointLightComponent.h"
+#include "Hash/CityHash.h"
+
+#include "BspFactory.h"
+#include "ImportStats.h"
 
 /*
 =======================================
@@ -139,6 +144,9 @@ void DeserializeBlock(const FString& in, AttributeGroup& attributes)
     FString left;
     FString right;
 
+    FString block = in.TrimStartAndEnd();
+    attributes.SetHash(CityHash64((const char*)*block, block.Len() * sizeof(TCHAR)));
+
     while (input.Split("\"", &left, &right, ESearchCase::IgnoreCase, ESearchDir::FromStart))
     {
         right.Split("\"", &left, &right, ESearchCase::IgnoreCase, ESearchDir::FromStart);
@@ -157,6 +165,8 @@ void DeserializeBlock(const FString& in, AttributeGroup& attributes)
 
 void DeserializeGroup(const FString& in, TArray<AttributeGroup>& attributeGroup)
 {
+    QUAKE_IMPORT_SCOPE("ParseEntities");
+
     FString input = in;
     FString left;
     FString right;
@@ -171,48 +181,201 @@ void DeserializeGroup(const FString& in, TArray<AttributeGroup>& attributeGroup)
     }
 }
 
-void EntityMaker(UWorld& world, const TArray<AttributeGroup>& entities)
+AActor* MakeEntity(UWorld& world, const AttributeGroup& entity)
 {
-    for (const auto& it : entities)
+    FString classname;
+
+    if (entity.Get("classname") == nullptr)
     {
-        FString classname;
+        // TODO log error
+        return nullptr;
+    }
+
+    classname = entity.Get("classname")->ToString();
+
+    float   angle = 0;
+    FVector origin(0, 0, 0);
+
+    if (entity.Get("origin"))
+    {
+        origin = entity.Get("origin")->ToVector3f();
+    }
 
-        if (it.Get("classname") == nullptr)
+    if (entity.Get("angle"))
+    {
+        angle = entity.Get("angle")->ToFloat();
+    }
+
+    if (classname == "light")
+    {
+        APointLight* PointLight = Cast<APointLight>(GEditor->AddActor(world.GetCurrentLevel(), APointLight::StaticClass(), FTransform(origin)));
+
+        UPointLightComponent* pointlightComponent = PointLight->FindComponentByClass<UPointLightComponent>();
+        pointlightComponent->SetMobility(EComponentMobility::Static);
+
+        if (entity.Get("light"))
         {
-            // TODO log error
-            continue;
+            pointlightComponent->Intensity = entity.Get("light")->ToInteger() * 10 * 2;
         }
 
-        classname = it.Get("classname")->ToString();
+        return PointLight;
+    }
 
-        float   angle = 0;
-        FVector origin(0, 0, 0);
+    return nullptr;
+}
 
-        if (it.Get("origin"))
+static FName EntityTag(uint64 hash)
+{
+    return FName(*FString::Printf(TEXT("QuakeEntity_%016llx"), hash));
+}
+
+static bool HasEntityTag(const AActor& actor)
+{
+    return actor.Tags.ContainsByPredicate([](const FName& tag) { return tag.ToString().StartsWith(TEXT("QuakeEntity_")); });
+}
+
+// Class MakeEntity spawns for the entity, nullptr for unsupported classnames
+static UClass* EntityClass(const AttributeGroup& entity)
+{
+    const Attribute* classname = entity.Get("classname");
+
+    if (classname && classname->ToString() == "light")
+    {
+        return APointLight::StaticClass();
+    }
+
+    return nullptr;
+}
+
+// Set on the world settings once the level actors carry entity tags
+static const FName ENTITY_TAGS_MARKER(TEXT("QuakeEntityTags"));
+
+// Imports before entity tags left untagged actors. Tag the ones whose class and origin match an
+// entity of the map so they are kept instead of spawned twice, anything else is left alone.
+static int AdoptUntaggedActors(UWorld& world, const TArray<AttributeGroup>& entities, TMap<FName, TArray<AActor*>>& existing)
+{
+    TArray<AActor*> untagged;
+
+    for (AActor* actor : world.GetCurrentLevel()->Actors)
+    {
+        if (actor && !HasEntityTag(*actor))
         {
-            origin = it.Get("origin")->ToVector3f();
+            untagged.Add(actor);
         }
+    }
+
+    int adopted = 0;
 
-        if (it.Get("angle"))
+    for (const AttributeGroup& entity : entities)
+    {
+        UClass* entityClass = EntityClass(entity);
+        FName tag = EntityTag(entity.GetHash());
+
+        if (!entityClass || existing.Contains(tag))
         {
-            angle = it.Get("angle")->ToFloat();
+            continue;
         }
 
-        if (classname == "light")
+        FVector origin = entity.Get("origin") ? entity.Get("origin")->ToVector3f() : FVector::ZeroVector;
+
+        int index = untagged.IndexOfByPredicate([&](const AActor* actor)
         {
-            ULevel* level = world.GetCurrentLevel();
-            APointLight* PointLight = Cast<APointLight>(GEditor->AddActor(world.GetCurrentLevel(), APointLight::StaticClass(), FTransform(origin)));
+            return actor->GetClass() == entityClass && actor->GetActorLocation().Equals(origin, 0.5);
+        });
 
-            UPointLightComponent* pointlightComponent = PointLight->FindComponentByClass<UPointLightComponent>();
-            pointlightComponent->SetMobility(EComponentMobility::Static);
+        if (index == INDEX_NONE)
+        {
+            continue;
+        }
+
+        AActor* actor = untagged[index];
+        untagged.RemoveAtSwap(index);
+
+        actor->Modify();
+        actor->Tags.Add(tag);
+        existing.FindOrAdd(tag).Add(actor);
+        adopted++;
+    }
+
+    return adopted;
+}
+
+void EntityMaker(UWorld& world, const TArray<AttributeGroup>& entities)
+{
+    QUAKE_IMPORT_SCOPE("SpawnEntities");
+
+    // Actors spawned by a previous import, by entity hash
+    TMap<FName, TArray<AActor*>> existing;
 
-            if (it.Get("light"))
+    for (AActor* actor : world.GetCurrentLevel()->Actors)
+    {
+        if (!actor)
+        {
+            continue;
+        }
+
+        for (const FName& tag : actor->Tags)
+        {
+            if (tag.ToString().StartsWith(TEXT("QuakeEntity_")))
             {
-                pointlightComponent->Intensity = it.Get("light")->ToInteger() * 10 * 2;
+                existing.FindOrAdd(tag).Add(actor);
             }
+        }
+    }
+
+    int kept = 0;
+    int spawned = 0;
+    int removed = 0;
+
+    // One time migration of levels imported before entity tags, the marker keeps it from
+    // touching lights placed by hand on later reimports
+    AWorldSettings* worldSettings = world.GetWorldSettings();
+
+    if (worldSettings && !worldSettings->Tags.Contains(ENTITY_TAGS_MARKER))
+    {
+        int adopted = AdoptUntaggedActors(world, entities, existing);
+
+        if (adopted)
+        {
+            UE_LOG(LogQuakeImporter, Log, TEXT("Entities: %d untagged actors from an earlier import matched to their entity."), adopted);
+        }
+
+        worldSettings->Modify();
+        worldSettings->Tags.Add(ENTITY_TAGS_MARKER);
+    }
+
+    for (const auto& it : entities)
+    {
+        FName tag = EntityTag(it.GetHash());
+
+        TArray<AActor*>* actors = existing.Find(tag);
+
+        if (actors && actors->Num() > 0)
+        {
+            actors->Pop();
+            kept++;
+            continue;
+        }
 
-            GEditor->EditorUpdateComponents();
-            world.UpdateWorldComponents(true, false);
+        if (AActor* actor = MakeEntity(world, it))
+        {
+            actor->Tags.Add(tag);
+            spawned++;
         }
     }
+
+    // Whatever was not matched belongs to entities removed or modified in the map
+    for (auto& it : existing)
+    {
+        for (AActor* actor : it.Value)
+        {
+            world.EditorDestroyActor(actor, false);
+            removed++;
+        }
+    }
+
+    GEditor->EditorUpdateComponents();
+    world.UpdateWorldComponents(true, false);
+
+    UE_LOG(LogQuakeImporter, Log, TEXT("Entities: %d kept, %d spawned, %d removed."), kept, spawned, removed);
 }
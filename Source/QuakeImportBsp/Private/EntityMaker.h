@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 
+class AActor;
 class UWorld;
 
 /*
@@ -43,7 +44,8 @@ class AttributeGroup
 {
 public:
     AttributeGroup() :
-        attributes_()
+        attributes_(),
+        hash_(0)
     {
         mask_.Add(TEXT("angle"), false);
         mask_.Add(TEXT("classname"), false);
@@ -60,9 +62,14 @@ public:
     bool Set(FString name, FString value);
     const Attribute *Get(FString name) const;
 
+    // Hash of the entity block text, identifies the entity across reimports
+    uint64 GetHash() const { return hash_; }
+    void SetHash(uint64 hash) { hash_ = hash; }
+
 private:
     TMap<FString, bool> mask_;
     TMap<FString, Attribute> attributes_;
+    uint64 hash_;
 };
 
 /*
@@ -74,5 +81,11 @@ Map entity description Deserializer
 
 void DeserializeBlock(const FString& in, AttributeGroup& attributes);
 void DeserializeGroup(const FString& in, TArray<AttributeGroup>& attributeGroup);
+
+// Spawn the actor for a single entity. Returns nullptr for unsupported classnames.
+AActor* MakeEntity(UWorld& world, const AttributeGroup& entity);
+
+// Bring the world entities in sync with the map. Actors whose entity is unchanged are kept,
+// new or modified entities are spawned and actors of removed entities are destroyed.
 void EntityMaker(UWorld& world, const TArray<AttributeGroup>& entities);
 
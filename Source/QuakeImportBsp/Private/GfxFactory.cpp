@@ -6,12 +6,24 @@
 #include "AssetRegistryModule.h"
 #include "AssetToolsModule.h"
 #include "PackageTools.h"
+#include "Engine/DataTable.h"
 #include "Engine/Texture2D.h"
+#include "Hash/CityHash.h"
 #include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
 #include "UObject/Package.h"
 
 // Quake
 #include "QuakeCommon.h"
+#include "BspFactory.h"
+#include "ImportCache.h"
+#include "ImportSession.h"
+#include "ImportStats.h"
+#include "QuakeAtlasEntry.h"
+#include "QuakeImportSettings.h"
+#include "RectPacker.h"
+#include "Wad.h"
 
 #define LOCTEXT_NAMESPACE "GfxFactory"
 
@@ -20,12 +32,186 @@ UGfxFactory::UGfxFactory(const FObjectInitializer& ObjectInitializer) :
 {
     SupportedClass = UTexture2D::StaticClass();
     Formats.Add(TEXT("lmp;Quake lmp graphic files"));
+    Formats.Add(TEXT("wad;Quake WAD2 graphic files"));
     bCreateNew = false;
     bEditorImport = true;
 }
 
+// Packed and converted wad images. Stored in the import cache.
+struct WadAtlas
+{
+    TArray<FString>         names;
+    TArray<FIntPoint>       sizes;
+    TArray<FIntVector>      rects;      // page, x, y of each image
+    TArray<FIntPoint>       pageSizes;
+    TArray<TArray<uint8>>   pages;      // BGRA8
+};
+
+FArchive& operator<<(FArchive& ar, WadAtlas& atlas)
+{
+    return ar << atlas.names << atlas.sizes << atlas.rects << atlas.pageSizes << atlas.pages;
+}
+
+void BuildWadAtlas(const Wad& wad, const TArray<QuakeCommon::QColor>& pal, WadAtlas& out)
+{
+    QUAKE_IMPORT_SCOPE("PackAtlas");
+
+    TArray<WadImage> images;
+    wad.ReadImages(images);
+
+    // Pack every image
+    for (const WadImage& image : images)
+    {
+        out.names.Add(image.name);
+        out.sizes.Add(FIntPoint(image.width, image.height));
+    }
+
+    RectPacker packer(GetDefault<UQuakeImportSettings>()->GfxAtlasSize, 1);
+    TArray<PackedRect> rects;
+    packer.Pack(out.sizes, rects);
+
+    out.pages.SetNum(packer.GetNumPages());
+
+    for (int i = 0; i < out.pages.Num(); i++)
+    {
+        FIntPoint pageSize = packer.GetPageSize(i);
+        out.pageSizes.Add(pageSize);
+        out.pages[i].SetNumZeroed(pageSize.X * pageSize.Y * 4);
+    }
+
+    TArray<uint8> pixels;
+
+    for (int i = 0; i < images.Num(); i++)
+    {
+        const WadImage& image = images[i];
+        const PackedRect& rect = rects[i];
+        int pageWidth = out.pageSizes[rect.page].X;
+
+        out.rects.Add(FIntVector(rect.page, rect.x, rect.y));
+
+        QuakeCommon::ExpandPalette(image.data, pal, pixels, image.transparentIndex);
+
+        for (int y = 0; y < image.height; y++)
+        {
+            FMemory::Memcpy(
+                out.pages[rect.page].GetData() + (((rect.y + y) * pageWidth) + rect.x) * 4,
+                pixels.GetData() + (y * image.width * 4),
+                image.width * 4);
+        }
+    }
+}
+
+UObject* ImportWad(const FString& name, const uint8* buffer, const uint8* bufferEnd, QuakeCommon::ImportPackages& packages, TArray<QuakeCommon::QColor>& pal)
+{
+    Wad wad(buffer, bufferEnd - buffer);
+
+    if (!wad.IsValid())
+    {
+        UE_LOG(LogQuakeImporter, Error, TEXT("Failed to import wad file '%s'. Not a WAD2 file."), *name);
+        return nullptr;
+    }
+
+    FString atlasName = name + "_atlas";
+
+    UPackage& package = packages.ForAsset(atlasName);
+
+    if (UObject* existing = QuakeCommon::CheckIfAssetExist<UDataTable>(atlasName, package))
+    {
+        return existing;
+    }
+
+    // Fall back on the wad palette
+    const WadLump* palette = wad.FindLump(TEXT("palette"));
+
+    if (!pal.Num() && palette && palette->type == WAD_TYP_PALETTE && palette->size >= 256 * (int)sizeof(QuakeCommon::QColor))
+    {
+        pal.Append(reinterpret_cast<const QuakeCommon::QColor*>(wad.GetLumpData(*palette)), 256);
+    }
+
+    if (!pal.Num())
+    {
+        UE_LOG(LogQuakeImporter, Error, TEXT("Palette.lmp not found."));
+        return nullptr;
+    }
+
+    // Pack and convert, or reuse the pages of a previous import of the same wad
+    WadAtlas atlas;
+    FString settingsKey = FString::Printf(TEXT("%d %016llx"), GetDefault<UQuakeImportSettings>()->GfxAtlasSize, CityHash64((const char*)pal.GetData(), pal.Num() * sizeof(QuakeCommon::QColor)));
+    FString cacheKey = QuakeCommon::MakeCacheKey(TEXT("wad"), buffer, bufferEnd - buffer, settingsKey);
+
+    TArray<uint8> cached;
+    bool cacheHit = false;
+
+    if (QuakeCommon::LoadCachedData(cacheKey, cached))
+    {
+        FMemoryReader reader(cached);
+        reader << atlas;
+        cacheHit = !reader.IsError();
+    }
+
+    if (!cacheHit)
+    {
+        atlas = WadAtlas();
+        BuildWadAtlas(wad, pal, atlas);
+
+        TArray<uint8> data;
+        FMemoryWriter writer(data);
+        writer << atlas;
+        QuakeCommon::StoreCachedData(cacheKey, data);
+    }
+
+    // Atlas textures
+    TArray<UTexture2D*> textures;
+
+    for (int i = 0; i < atlas.pages.Num(); i++)
+    {
+        FIntPoint pageSize = atlas.pageSizes[i];
+        FString textureName = atlasName + "_" + FString::FromInt(i);
+        UTexture2D* texture = QuakeCommon::CreateUTexture2DFromBGRA(textureName, pageSize.X, pageSize.Y, atlas.pages[i], packages.ForAsset(textureName + "_color"));
+
+        if (texture)
+        {
+            texture->Filter = TextureFilter::TF_Nearest;
+            texture->LODGroup = TextureGroup::TEXTUREGROUP_UI;
+            texture->CompressionSettings = TextureCompressionSettings::TC_EditorIcon; // keep BGRA8, no block compression on pixel art
+            texture->PostEditChange();
+        }
+
+        textures.Add(texture);
+    }
+
+    // Lookup table
+    UDataTable* table = NewObject<UDataTable>(&package, FName(*atlasName), RF_Public | RF_Standalone);
+    QuakeCommon::ImportSession::Root(*table);
+    table->RowStruct = FQuakeAtlasEntry::StaticStruct();
+
+    for (int i = 0; i < atlas.names.Num(); i++)
+    {
+        const FIntVector& rect = atlas.rects[i]; // page, x, y
+        FIntPoint pageSize = atlas.pageSizes[rect.X];
+
+        FQuakeAtlasEntry row;
+        row.Texture = textures[rect.X];
+        row.Width = atlas.sizes[i].X;
+        row.Height = atlas.sizes[i].Y;
+        row.UVMin = FVector2D((float)rect.Y / pageSize.X, (float)rect.Z / pageSize.Y);
+        row.UVMax = FVector2D((float)(rect.Y + row.Width) / pageSize.X, (float)(rect.Z + row.Height) / pageSize.Y);
+        table->AddRow(FName(*atlas.names[i]), row);
+    }
+
+    FAssetRegistryModule::AssetCreated(table);
+    package.MarkPackageDirty();
+
+    UE_LOG(LogQuakeImporter, Log, TEXT("%s: packed %d lumps in %d atlas textures."), *name, atlas.names.Num(), atlas.pages.Num());
+
+    return table;
+}
+
 UObject* UGfxFactory::FactoryCreateBinary(UClass* InClass, UObject* InParent, FName Name, EObjectFlags Flags, UObject* Context, const TCHAR* Type, const uint8*& Buffer, const uint8* BufferEnd, FFeedbackContext* Warn)
 {
+    QuakeCommon::ImportReport report(TEXT("Gfx"), Name.ToString());
+    QuakeCommon::ImportSession session;
+
     // Load Palette
     TArray<QuakeCommon::QColor> quakePalette;
 
@@ -34,9 +220,17 @@ UObject* UGfxFactory::FactoryCreateBinary(UClass* InClass, UObject* InParent, FN
         // ERROR
     }
 
-    // Create Package
-    FString packageName = TEXT("/Game/Graphics/Graphics");
-    UPackage* package = CreatePackage(nullptr, *packageName);
+    // Shared or one package per asset depending on the project settings
+    QuakeCommon::ImportPackages packages(TEXT("/Game/Graphics/Graphics"));
+
+    if (FCString::Stricmp(Type, TEXT("wad")) == 0)
+    {
+        UObject* atlas = ImportWad(Name.ToString(), Buffer, BufferEnd, packages, quakePalette);
+        packages.SaveDirty();
+        return atlas;
+    }
+
+    UPackage* package = &packages.ForAsset(Name.ToString() + "_color");
     package->FullyLoad();
 
     int width = 0;
@@ -53,6 +247,7 @@ UObject* UGfxFactory::FactoryCreateBinary(UClass* InClass, UObject* InParent, FN
     TArray<uint8> data;
     data.Append(Buffer + sizeof(int) * 2, width*height);
     UTexture2D* texture2D = QuakeCommon::CreateUTexture2D(Name.ToString(), width, height, data, *package, quakePalette);
+    packages.SaveDirty();
     return texture2D;
 }
 
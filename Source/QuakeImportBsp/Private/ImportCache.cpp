@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ImportCache.h"
+
+// Epic
+#include "Hash/CityHash.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+// Quake Import
+#include "QuakeImportSettings.h"
+#include "ImportStats.h"
+
+namespace QuakeCommon
+{
+    static const uint32 IMPORT_CACHE_MAGIC = 0x31434951; // "QIC1"
+
+    struct CacheEntryHeader
+    {
+        uint32  magic;
+        uint32  version;
+        int32   uncompressedSize;
+    };
+
+    static const FString& GetPluginVersion()
+    {
+        // Looked up once, cache keys are also made on import worker tasks
+        static const FString version = []()
+        {
+            TSharedPtr<IPlugin> plugin = IPluginManager::Get().FindPlugin(TEXT("QuakeImport"));
+            return plugin.IsValid() ? plugin->GetDescriptor().VersionName : FString();
+        }();
+
+        return version;
+    }
+
+    static FString GetCacheFilename(const FString& key)
+    {
+        return FPaths::ProjectSavedDir() / TEXT("QuakeImportCache") / key + TEXT(".bin");
+    }
+
+    FString MakeCacheKey(const TCHAR* product, uint64 sourceHash, const FString& settings)
+    {
+        FString versioned = settings + TEXT("|") + GetPluginVersion() + TEXT("|") + FString::FromInt(IMPORT_CACHE_VERSION);
+        uint64 hash = CityHash64WithSeed((const char*)*versioned, versioned.Len() * sizeof(TCHAR), sourceHash);
+
+        return FString::Printf(TEXT("%s_%016llx"), product, hash);
+    }
+
+    FString MakeCacheKey(const TCHAR* product, const uint8* data, int64 size, const FString& settings)
+    {
+        return MakeCacheKey(product, CityHash64((const char*)data, size), settings);
+    }
+
+    bool LoadCachedData(const FString& key, TArray<uint8>& out)
+    {
+        QUAKE_IMPORT_SCOPE("CacheLoad");
+
+        if (!GetDefault<UQuakeImportSettings>()->bUseImportCache)
+        {
+            return false;
+        }
+
+        TArray<uint8> file;
+
+        if (!FFileHelper::LoadFileToArray(file, *GetCacheFilename(key), FILEREAD_Silent))
+        {
+            return false;
+        }
+
+        if (file.Num() < (int32)sizeof(CacheEntryHeader))
+        {
+            return false;
+        }
+
+        CacheEntryHeader header;
+        FMemory::Memcpy(&header, file.GetData(), sizeof(header));
+
+        if (header.magic != IMPORT_CACHE_MAGIC || header.version != IMPORT_CACHE_VERSION || header.uncompressedSize < 0)
+        {
+            return false;
+        }
+
+        out.SetNumUninitialized(header.uncompressedSize);
+
+        return FCompression::UncompressMemory(
+            NAME_Zlib,
+            out.GetData(),
+            header.uncompressedSize,
+            file.GetData() + sizeof(header),
+            file.Num() - sizeof(header));
+    }
+
+    void StoreCachedData(const FString& key, const TArray<uint8>& data)
+    {
+        QUAKE_IMPORT_SCOPE("CacheStore");
+
+        if (!GetDefault<UQuakeImportSettings>()->bUseImportCache)
+        {
+            return;
+        }
+
+        int32 compressedSize = FCompression::CompressMemoryBound(NAME_Zlib, data.Num());
+
+        TArray<uint8> file;
+        file.SetNumUninitialized(sizeof(CacheEntryHeader) + compressedSize);
+
+        if (!FCompression::CompressMemory(NAME_Zlib, file.GetData() + sizeof(CacheEntryHeader), compressedSize, data.GetData(), data.Num()))
+        {
+            return;
+        }
+
+        CacheEntryHeader header = { IMPORT_CACHE_MAGIC, IMPORT_CACHE_VERSION, data.Num() };
+        FMemory::Memcpy(file.GetData(), &header, sizeof(header));
+        file.SetNum(sizeof(CacheEntryHeader) + compressedSize);
+
+        // Written to a temporary file first so concurrent imports and worker tasks never read a partial entry
+        FString filename = GetCacheFilename(key);
+        FString tempFilename = filename + FString::Printf(TEXT(".%u.%u.tmp"), FPlatformProcess::GetCurrentProcessId(), FPlatformTLS::GetCurrentThreadId());
+
+        if (FFileHelper::SaveArrayToFile(file, *tempFilename))
+        {
+            IFileManager::Get().Move(*filename, *tempFilename, true, true);
+        }
+    }
+
+} // namespace QuakeCommon
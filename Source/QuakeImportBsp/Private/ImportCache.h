@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+============================================
+Import cache
+
+Local derived data cache for converted import products: pixel buffers,
+mesh streams and VAT texels. They are a pure function of the source bytes
+and the import settings, so a repeated import of the same content skips
+straight to asset creation. Entries live in Saved/QuakeImportCache, zlib
+compressed, keyed by product, source hash, settings and plugin version.
+============================================
+*/
+
+namespace QuakeCommon
+{
+    // Bump when the layout of any cached product changes
+    constexpr uint32 IMPORT_CACHE_VERSION = 3;
+
+    // settings is a string of every import option the product depends on
+    FString MakeCacheKey(const TCHAR* product, uint64 sourceHash, const FString& settings);
+    FString MakeCacheKey(const TCHAR* product, const uint8* data, int64 size, const FString& settings);
+
+    // False on a miss, a corrupt entry or when the cache is disabled in the project settings
+    bool LoadCachedData(const FString& key, TArray<uint8>& out);
+
+    void StoreCachedData(const FString& key, const TArray<uint8>& data);
+
+} // namespace QuakeCommon
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ImportSession.h"
+#include "UObject/Package.h"
+
+namespace QuakeCommon
+{
+    namespace
+    {
+        ImportSession* s_currentSession = nullptr;
+    }
+
+    ImportSession::ImportSession() :
+        m_previous(s_currentSession)
+    {
+        check(IsInGameThread());
+        s_currentSession = this;
+    }
+
+    ImportSession::~ImportSession()
+    {
+        s_currentSession = m_previous;
+
+        for (int i = m_owned.Num(); i-- > 0;)
+        {
+            m_owned[i].Reset();
+        }
+
+        m_owned.Empty();
+
+        for (const TWeakObjectPtr<UObject>& weak : m_rooted)
+        {
+            UObject* object = weak.Get();
+
+            if (!object)
+            {
+                continue;
+            }
+
+            object->RemoveFromRoot();
+
+            // A batch import never looks at an asset again once its package is on disk, a later
+            // LoadObject brings it back. Let the next collection drop it so memory stays flat.
+            if (IsRunningCommandlet() && !object->GetPackage()->IsDirty() && !object->IsA<UPackage>())
+            {
+                object->ClearFlags(RF_Standalone);
+            }
+        }
+    }
+
+    void ImportSession::Root(UObject& object)
+    {
+        object.AddToRoot();
+
+        if (s_currentSession)
+        {
+            s_currentSession->m_rooted.Add(&object);
+        }
+    }
+
+} // namespace QuakeCommon
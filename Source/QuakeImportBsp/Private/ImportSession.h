@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+============================================
+Import session
+
+Lifetime of one file import. Parse structures handed to Own live until
+the session ends, and objects passed to Root are rooted only until then,
+so nothing is collected halfway through and nothing stays rooted after
+the packages are saved. Declare the session after the ImportReport so
+its release is part of the import time.
+
+Sessions nest, objects are released by the innermost one. Game thread only.
+============================================
+*/
+
+namespace QuakeCommon
+{
+    class ImportSession
+    {
+    public:
+        ImportSession();
+        ~ImportSession();
+
+        // Keep an object from garbage collection until the session ends.
+        // Outside a session it stays rooted for good, like before sessions existed.
+        static void Root(UObject& object);
+
+        // Take ownership of transient parse data, freed in reverse order when the session ends
+        template<typename T>
+        T& Own(TUniquePtr<T> object)
+        {
+            T& ref = *object;
+            m_owned.Add(MakeUnique<Owned<T>>(MoveTemp(object)));
+            return ref;
+        }
+
+    private:
+        struct OwnedBase
+        {
+            virtual ~OwnedBase() {}
+        };
+
+        template<typename T>
+        struct Owned : OwnedBase
+        {
+            Owned(TUniquePtr<T>&& inObject) : object(MoveTemp(inObject)) {}
+
+            TUniquePtr<T> object;
+        };
+
+        TArray<TUniquePtr<OwnedBase>>   m_owned;
+        TArray<TWeakObjectPtr<UObject>> m_rooted;
+        ImportSession*                  m_previous;
+    };
+
+} // namespace QuakeCommon
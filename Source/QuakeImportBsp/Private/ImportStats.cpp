@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ImportStats.h"
+
+// Epic
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+// Quake Import
+#include "BspFactory.h"
+
+namespace QuakeCommon
+{
+    static ImportReport* GCurrentReport = nullptr;
+    static FString GReportFilename;
+
+    ImportReport::ImportReport(const TCHAR* factory, const FString& sourceName) :
+        m_factory(factory),
+        m_sourceName(sourceName),
+        m_startTime(FPlatformTime::Seconds()),
+        m_previous(GCurrentReport)
+    {
+        check(IsInGameThread());
+        GCurrentReport = this;
+    }
+
+    ImportReport::~ImportReport()
+    {
+        GCurrentReport = m_previous;
+        Write();
+    }
+
+    void ImportReport::AddStage(const TCHAR* stage, double seconds)
+    {
+        // Worker stages only run while the game thread waits inside the report
+        if (!GCurrentReport)
+        {
+            return;
+        }
+
+        FScopeLock lock(&GCurrentReport->m_stagesLock);
+
+        // Stage names are literals from QUAKE_IMPORT_SCOPE, compare pointers first
+        Stage* entry = GCurrentReport->m_stages.FindByPredicate([stage](const Stage& it) { return it.name == stage || FCString::Strcmp(it.name, stage) == 0; });
+
+        if (!entry)
+        {
+            entry = &GCurrentReport->m_stages.Add_GetRef({ stage, 0.0, 0 });
+        }
+
+        entry->seconds += seconds;
+        entry->count++;
+    }
+
+    void ImportReport::Write() const
+    {
+        double totalSeconds = FPlatformTime::Seconds() - m_startTime;
+
+        TSharedRef<FJsonObject> stages = MakeShared<FJsonObject>();
+
+        for (const Stage& stage : m_stages)
+        {
+            TSharedRef<FJsonObject> entry = MakeShared<FJsonObject>();
+            entry->SetNumberField(TEXT("seconds"), stage.seconds);
+            entry->SetNumberField(TEXT("count"), stage.count);
+            stages->SetObjectField(stage.name, entry);
+        }
+
+        TSharedPtr<IPlugin> plugin = IPluginManager::Get().FindPlugin(TEXT("QuakeImport"));
+
+        TSharedRef<FJsonObject> report = MakeShared<FJsonObject>();
+        report->SetStringField(TEXT("time"), FDateTime::UtcNow().ToIso8601());
+        report->SetStringField(TEXT("pluginVersion"), plugin.IsValid() ? plugin->GetDescriptor().VersionName : FString());
+        report->SetStringField(TEXT("factory"), m_factory);
+        report->SetStringField(TEXT("source"), m_sourceName);
+        report->SetNumberField(TEXT("seconds"), totalSeconds);
+        report->SetObjectField(TEXT("stages"), stages);
+
+        FString line;
+        TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&line);
+        FJsonSerializer::Serialize(report, writer);
+        line += LINE_TERMINATOR;
+
+        FString filename = GReportFilename.IsEmpty() ? GetDefaultFilename() : GReportFilename;
+        FFileHelper::SaveStringToFile(line, *filename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+
+        UE_LOG(LogQuakeImporter, Log, TEXT("%s '%s' imported in %.3fs."), m_factory, *m_sourceName, totalSeconds);
+    }
+
+    void ImportReport::SetFilename(const FString& filename)
+    {
+        check(IsInGameThread());
+        GReportFilename = filename;
+    }
+
+    FString ImportReport::GetDefaultFilename()
+    {
+        return FPaths::ProjectLogDir() / TEXT("QuakeImportReport.jsonl");
+    }
+
+    void ImportReport::Merge(const TArray<FString>& filenames)
+    {
+        // Only the coordinator writes the default file while workers run, one append per worker keeps lines whole
+        FString filename = GetDefaultFilename();
+
+        for (const FString& workerFilename : filenames)
+        {
+            FString lines;
+
+            if (FFileHelper::LoadFileToString(lines, *workerFilename))
+            {
+                FFileHelper::SaveStringToFile(lines, *filename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+                IFileManager::Get().Delete(*workerFilename);
+            }
+        }
+    }
+
+} // namespace QuakeCommon
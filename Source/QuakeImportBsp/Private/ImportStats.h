@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+/*
+============================================
+Import stats
+
+QUAKE_IMPORT_SCOPE("Stage") marks a pipeline stage. It shows up as a
+CPU trace event in Unreal Insights and its duration is added to the
+ImportReport of the import in progress. Stages nest, their times are
+inclusive. Stages running on worker tasks count too, so parallel
+stages can add up past the total time. Each report is appended as one
+JSON line to <ProjectLogDir>/QuakeImportReport.jsonl. Import workers
+write a file of their own, the coordinator merges them when they exit.
+============================================
+*/
+
+#define QUAKE_IMPORT_SCOPE(Stage) \
+    TRACE_CPUPROFILER_EVENT_SCOPE_STR("QuakeImport::" Stage); \
+    QuakeCommon::ImportStageScope PREPROCESSOR_JOIN(quakeImportStage, __LINE__)(TEXT(Stage))
+
+namespace QuakeCommon
+{
+    // Stage durations of one file import. Created on the game thread, the innermost report receives the stages.
+    class ImportReport
+    {
+    public:
+        ImportReport(const TCHAR* factory, const FString& sourceName);
+        ~ImportReport();
+
+        static void AddStage(const TCHAR* stage, double seconds);
+
+        // File the reports of this process are appended to
+        static void SetFilename(const FString& filename);
+        static FString GetDefaultFilename();
+
+        // Append the reports of worker processes to the default file, then delete them
+        static void Merge(const TArray<FString>& filenames);
+
+    private:
+        struct Stage
+        {
+            const TCHAR*    name;
+            double          seconds;
+            int             count;
+        };
+
+        void Write() const;
+
+        const TCHAR*        m_factory;
+        FString             m_sourceName;
+        double              m_startTime;
+        TArray<Stage>       m_stages;   // in first run order
+        FCriticalSection    m_stagesLock;
+        ImportReport*       m_previous;
+    };
+
+    class ImportStageScope
+    {
+    public:
+        ImportStageScope(const TCHAR* stage) :
+            m_stage(stage),
+            m_startTime(FPlatformTime::Seconds())
+        {
+            /* do nothing */
+        }
+
+        ~ImportStageScope()
+        {
+            ImportReport::AddStage(m_stage, FPlatformTime::Seconds() - m_startTime);
+        }
+
+    private:
+        const TCHAR*    m_stage;
+        double          m_startTime;
+    };
+
+} // namespace QuakeCommon
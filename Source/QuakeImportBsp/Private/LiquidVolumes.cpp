@@ -0,0 +1,225 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LiquidVolumes.h"
+
+// Epic
+#include "ActorFactories/ActorFactory.h"
+#include "Builders/CubeBuilder.h"
+#include "Editor.h"
+#include "Engine/World.h"
+#include "GameFramework/PainCausingVolume.h"
+#include "GameFramework/PhysicsVolume.h"
+
+// Quake Import
+#include "BspFactory.h"
+#include "BspHulls.h"
+#include "ImportStats.h"
+
+namespace bsputils
+{
+    namespace
+    {
+        const FName LIQUID_TAG(TEXT("QuakeLiquid"));
+
+        struct LiquidCluster
+        {
+            FBox3f  box;
+            float   volume;         // liquid inside the box, the member leaves are disjoint
+            int     numLeaves;
+            int     version = 0;    // bumped on every merge, queued pairs of an older version are stale
+            bool    merged = false;
+        };
+
+        // Two clusters that touch, cost is the box volume of the union over the liquid it holds
+        struct ClusterPair
+        {
+            float   cost;
+            int     a;
+            int     b;
+            int     versionA;
+            int     versionB;
+
+            bool operator<(const ClusterPair& other) const { return cost < other.cost; }
+        };
+
+        float BoxVolume(const FBox3f& box)
+        {
+            FVector3f size = box.GetSize();
+            return size.X * size.Y * size.Z;
+        }
+
+        void QueuePair(const TArray<LiquidCluster>& clusters, int a, int b, TArray<ClusterPair>& queue)
+        {
+            // Touching or overlapping only, with a little slack for float corners
+            if (!clusters[a].box.ExpandBy(1.0f).Intersect(clusters[b].box))
+            {
+                return;
+            }
+
+            float cost = BoxVolume(clusters[a].box + clusters[b].box) / FMath::Max(clusters[a].volume + clusters[b].volume, UE_SMALL_NUMBER);
+            queue.HeapPush({ cost, a, b, clusters[a].version, clusters[b].version });
+        }
+
+        // Merge the fullest union first until none stays within tolerance
+        void MergeClusters(TArray<LiquidCluster>& clusters, float tolerance)
+        {
+            TArray<ClusterPair> queue;
+
+            for (int i = 0; i < clusters.Num(); i++)
+            {
+                for (int j = i + 1; j < clusters.Num(); j++)
+                {
+                    QueuePair(clusters, i, j, queue);
+                }
+            }
+
+            while (queue.Num())
+            {
+                ClusterPair pair;
+                queue.HeapPop(pair);
+
+                LiquidCluster& a = clusters[pair.a];
+                LiquidCluster& b = clusters[pair.b];
+
+                if (a.merged || b.merged || a.version != pair.versionA || b.version != pair.versionB)
+                {
+                    continue;
+                }
+
+                // Every pair left is at least as costly
+                if (pair.cost > 1.0f + tolerance)
+                {
+                    break;
+                }
+
+                a.box += b.box;
+                a.volume = FMath::Min(a.volume + b.volume, BoxVolume(a.box));
+                a.numLeaves += b.numLeaves;
+                a.version++;
+                b.merged = true;
+
+                for (int k = 0; k < clusters.Num(); k++)
+                {
+                    if (k != pair.a && !clusters[k].merged)
+                    {
+                        QueuePair(clusters, pair.a, k, queue);
+                    }
+                }
+            }
+
+            clusters.RemoveAll([](const LiquidCluster& cluster) { return cluster.merged; });
+        }
+
+        const TCHAR* ContentsName(ELeafContentType contents)
+        {
+            switch (contents)
+            {
+            case ELeafContentType::Slime: return TEXT("Slime");
+            case ELeafContentType::Lava: return TEXT("Lava");
+            default: return TEXT("Water");
+            }
+        }
+    }
+
+    void BuildLiquidVolumes(const bspformat29::Bsp_29& model, float tolerance, TArray<LiquidVolume>& out)
+    {
+        QUAKE_IMPORT_SCOPE("BuildLiquidVolumes");
+
+        if (!model.submodels.Num())
+        {
+            return;
+        }
+
+        const ELeafContentType liquids[] = { ELeafContentType::Water, ELeafContentType::Slime, ELeafContentType::Lava };
+
+        for (ELeafContentType contents : liquids)
+        {
+            TArray<HullRegion> regions;
+            BuildHullRegions(model, 0, 0, contents, 1.0f, regions);
+
+            TArray<LiquidCluster> clusters;
+
+            for (const HullRegion& region : regions)
+            {
+                LiquidCluster cluster;
+                cluster.box = FBox3f(region.points);
+                cluster.volume = region.volume;
+                cluster.numLeaves = 1;
+                clusters.Add(cluster);
+            }
+
+            MergeClusters(clusters, tolerance);
+
+            for (const LiquidCluster& cluster : clusters)
+            {
+                out.Add({ cluster.box, contents, cluster.numLeaves });
+            }
+
+            if (regions.Num())
+            {
+                UE_LOG(LogQuakeImporter, Log, TEXT("%s: %d leaf regions merged in %d volumes."), ContentsName(contents), regions.Num(), clusters.Num());
+            }
+        }
+    }
+
+    void SpawnLiquidVolumes(UWorld& world, const TArray<LiquidVolume>& volumes)
+    {
+        QUAKE_IMPORT_SCOPE("SpawnLiquidVolumes");
+
+        ULevel* level = world.GetCurrentLevel();
+
+        // Volumes are cheap to rebuild, replace whatever a previous import spawned
+        TArray<AActor*> previous;
+
+        for (AActor* actor : level->Actors)
+        {
+            if (actor && actor->Tags.Contains(LIQUID_TAG))
+            {
+                previous.Add(actor);
+            }
+        }
+
+        for (AActor* actor : previous)
+        {
+            world.EditorDestroyActor(actor, false);
+        }
+
+        for (const LiquidVolume& liquid : volumes)
+        {
+            // flip X axis
+            FVector center(-liquid.box.GetCenter().X, liquid.box.GetCenter().Y, liquid.box.GetCenter().Z);
+            FVector size(liquid.box.GetSize());
+
+            // Slime and lava hurt, at the full immersion rates of WaterMove in client.qc
+            UClass* volumeClass = liquid.contents == ELeafContentType::Water ? APhysicsVolume::StaticClass() : APainCausingVolume::StaticClass();
+            APhysicsVolume* volume = Cast<APhysicsVolume>(GEditor->AddActor(level, volumeClass, FTransform(center)));
+
+            if (!volume)
+            {
+                continue;
+            }
+
+            UCubeBuilder* builder = NewObject<UCubeBuilder>();
+            builder->X = size.X;
+            builder->Y = size.Y;
+            builder->Z = size.Z;
+            UActorFactory::CreateBrushForVolumeActor(volume, builder);
+
+            volume->bWaterVolume = true;
+            volume->FluidFriction = liquid.contents == ELeafContentType::Water ? 0.3f : 0.6f;
+            volume->Tags.Add(LIQUID_TAG);
+            volume->Tags.Add(ContentsName(liquid.contents));
+            volume->SetActorLabel(ContentsName(liquid.contents));
+
+            if (APainCausingVolume* painVolume = Cast<APainCausingVolume>(volume))
+            {
+                painVolume->bPainCausing = true;
+                painVolume->DamagePerSec = liquid.contents == ELeafContentType::Lava ? 150.0f : 12.0f;
+            }
+        }
+
+        GEditor->EditorUpdateComponents();
+        world.UpdateWorldComponents(true, false);
+    }
+
+} // namespace bsputils
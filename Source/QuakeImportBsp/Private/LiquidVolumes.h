@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BspUtilities.h"
+
+class UWorld;
+
+/*
+============================================
+Liquid volumes
+
+Water, slime and lava leaves of the world model merged into a few
+boxes. Neighbour regions of the same contents merge when their
+union box stays about as full as the regions it covers.
+============================================
+*/
+
+namespace bsputils
+{
+    struct LiquidVolume
+    {
+        FBox3f              box;        // Quake space
+        ELeafContentType    contents;
+        int                 numLeaves;
+    };
+
+    // tolerance is the fraction of the merged box allowed to be outside the liquid
+    void BuildLiquidVolumes(const bspformat29::Bsp_29& model, float tolerance, TArray<LiquidVolume>& out);
+
+    // Spawn one physics volume per liquid volume. Volumes of a previous import are replaced.
+    void SpawnLiquidVolumes(UWorld& world, const TArray<LiquidVolume>& volumes);
+
+} // namespace bsputils
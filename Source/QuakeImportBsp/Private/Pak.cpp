@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Pak.h"
+#include "QuakeCommon.h"
+#include "ImportStats.h"
+
+Pak::Pak(const uint8* buf, int64 size) :
+    m_buf(buf),
+    m_size(size),
+    m_valid(false)
+{
+    QUAKE_IMPORT_SCOPE("ParsePak");
+
+    if (size < (int64)sizeof(PakHeader))
+    {
+        return;
+    }
+
+    PakHeader header;
+    QuakeCommon::ReadData<PakHeader>(buf, 0, header);
+
+    if (FMemory::Memcmp(header.identification, "PACK", 4) != 0 ||
+        header.dirofs < 0 ||
+        header.dirlen < 0 ||
+        header.dirlen % sizeof(PakFileInfo) ||
+        header.dirofs + (int64)header.dirlen > size)
+    {
+        return;
+    }
+
+    int numFiles = header.dirlen / sizeof(PakFileInfo);
+    m_entries.Reserve(numFiles);
+
+    for (int i = 0; i < numFiles; i++)
+    {
+        PakFileInfo info;
+        QuakeCommon::ReadData<PakFileInfo>(buf, header.dirofs + (i * sizeof(PakFileInfo)), info);
+
+        if (info.filepos < 0 || info.filelen < 0 || info.filepos + (int64)info.filelen > size)
+        {
+            continue;
+        }
+
+        // names fill the whole field when 56 characters long
+        char name[sizeof(info.name) + 1] = {};
+        FMemory::Memcpy(name, info.name, sizeof(info.name));
+
+        PakEntry entry;
+        entry.name = FString(ANSI_TO_TCHAR(name)).ToLower().Replace(TEXT("\\"), TEXT("/"));
+        entry.filepos = info.filepos;
+        entry.filelen = info.filelen;
+        m_entries.Add(entry);
+    }
+
+    m_valid = true;
+}
+
+const PakEntry* Pak::FindEntry(const FString& name) const
+{
+    FString lowerName = name.ToLower();
+    return m_entries.FindByPredicate([&lowerName](const PakEntry& entry) { return entry.name == lowerName; });
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+============================================
+Pak
+
+Quake PACK archive (pak0.pak). Indexes the file directory,
+file data stays in the caller's buffer.
+============================================
+*/
+
+struct PakEntry
+{
+    FString name;   // path inside the pak, lower case, forward slashes
+    int     filepos;
+    int     filelen;
+};
+
+class Pak
+{
+public:
+    Pak(const uint8* buf, int64 size);
+
+    bool IsValid() const { return m_valid; }
+
+    TArray<PakEntry> m_entries;
+
+    const PakEntry* FindEntry(const FString& name) const;
+    const uint8* GetEntryData(const PakEntry& entry) const { return m_buf + entry.filepos; }
+
+private:
+
+    struct PakHeader
+    {
+        char    identification[4];
+        int     dirofs;
+        int     dirlen;
+    };
+
+    struct PakFileInfo
+    {
+        char    name[56];
+        int     filepos;
+        int     filelen;
+    };
+
+    const uint8*    m_buf;
+    int64           m_size;
+    bool            m_valid;
+};
@@ -2,18 +2,46 @@
 
 #include "AssetRegistryModule.h"
 #include "Interfaces/IPluginManager.h"
+#include "Engine/Classes/Materials/MaterialExpressionAdd.h"
+#include "Engine/Classes/Materials/MaterialExpressionAppendVector.h"
+#include "Engine/Classes/Materials/MaterialExpressionComponentMask.h"
 #include "Engine/Classes/Materials/MaterialExpressionConstant.h"
+#include "Engine/Classes/Materials/MaterialExpressionCustom.h"
+#include "Engine/Classes/Materials/MaterialExpressionDivide.h"
+#include "Engine/Classes/Materials/MaterialExpressionFloor.h"
+#include "Engine/Classes/Materials/MaterialExpressionFrac.h"
+#include "Engine/Classes/Materials/MaterialExpressionMultiply.h"
+#include "Engine/Classes/Materials/MaterialExpressionPanner.h"
+#include "Engine/Classes/Materials/MaterialExpressionPreSkinnedPosition.h"
+#include "Engine/Classes/Materials/MaterialExpressionScalarParameter.h"
+#include "Engine/Classes/Materials/MaterialExpressionSine.h"
+#include "Engine/Classes/Materials/MaterialExpressionTextureCoordinate.h"
+#include "Engine/Classes/Materials/MaterialExpressionTextureObjectParameter.h"
+#include "Engine/Classes/Materials/MaterialExpressionTextureSampleParameter2D.h"
+#include "Engine/Classes/Materials/MaterialExpressionTextureSampleParameter2DArray.h"
+#include "Engine/Classes/Materials/MaterialExpressionTime.h"
+#include "Engine/Classes/Materials/MaterialExpressionTransform.h"
+#include "Engine/Classes/Materials/MaterialExpressionVectorParameter.h"
+#include "Engine/Classes/Materials/MaterialExpressionVertexInterpolator.h"
 #include "Engine/Texture2D.h"
-#include "Factories/MaterialFactoryNew.h"
+#include "Engine/Texture2DArray.h"
 #include "Factories/TextureFactory.h"
 #include "Materials/Material.h"
+#include "Materials/MaterialInstanceConstant.h"
 #include "Misc/FileHelper.h"
+#include "UObject/MetaData.h"
 #include "UObject/Package.h"
 
+#include "QuakeImportSettings.h"
+#include "ImportSession.h"
+#include "ImportStats.h"
+
 namespace QuakeCommon
 {
     bool LoadPalette(TArray<QColor>& outPalette)
     {
+        QUAKE_IMPORT_SCOPE("LoadPalette");
+
         FString palFilename = IPluginManager::Get().FindPlugin(TEXT("QuakeImport"))->GetContentDir() / FString("palette.lmp");
 
         TArray<uint8> data;
@@ -30,30 +58,51 @@ namespace QuakeCommon
         return false;
     }
 
-    UTexture2D* CreateUTexture2D(const FString& name, int width, int height, const TArray<uint8>& data, UPackage& texturePackage, const TArray<QColor>& pal, bool savePackage)
+    void ExpandPalette(const TArray<uint8>& data, const TArray<QColor>& pal, TArray<uint8>& out, int transparentIndex)
     {
-        FString finalName = name + "_color";
+        QUAKE_IMPORT_SCOPE("ExpandPalette");
 
-        if (CheckIfAssetExist<UTexture2D>(finalName, texturePackage))
+        out.SetNumUninitialized(data.Num() * 4);
+        uint8* dst = out.GetData();
+
+        for (const auto& it : data)
+        {
+            *dst++ = pal[it].b;
+            *dst++ = pal[it].g;
+            *dst++ = pal[it].r;
+            *dst++ = it == transparentIndex ? 0 : 255;
+        }
+    }
+
+    UTexture2D* CreateUTexture2D(const FString& name, int width, int height, const TArray<uint8>& data, UPackage& texturePackage, const TArray<QColor>& pal, bool savePackage)
+    {
+        if (CheckIfAssetExist<UTexture2D>(name + "_color", texturePackage))
         {
             return nullptr;
         }
 
         // get colors from palette
         TArray<uint8> finalData;
+        ExpandPalette(data, pal, finalData);
 
-        for (const auto& it : data)
+        return CreateUTexture2DFromBGRA(name, width, height, finalData, texturePackage);
+    }
+
+    UTexture2D* CreateUTexture2DFromBGRA(const FString& name, int width, int height, const TArray<uint8>& data, UPackage& texturePackage)
+    {
+        QUAKE_IMPORT_SCOPE("CreateTexture");
+
+        FString finalName = name + "_color";
+
+        if (CheckIfAssetExist<UTexture2D>(finalName, texturePackage))
         {
-            finalData.Add(pal[it].b);
-            finalData.Add(pal[it].g);
-            finalData.Add(pal[it].r);
-            finalData.Add(255);
+            return nullptr;
         }
 
         // Create Texture
         UTexture2D* texture = NewObject<UTexture2D>(&texturePackage, FName(*finalName), RF_Public | RF_Standalone);
 
-        texture->AddToRoot();
+        ImportSession::Root(*texture);
         texture->PlatformData = new FTexturePlatformData();
         texture->PlatformData->SizeX = width;
         texture->PlatformData->SizeY = height;
@@ -66,7 +115,7 @@ namespace QuakeCommon
         texmip->BulkData.Lock(LOCK_READ_WRITE);
         uint32 textureDataSize = (width * height) * sizeof(uint8) * 4;
         uint8* textureData = (uint8*)texmip->BulkData.Realloc(textureDataSize);
-        FMemory::Memcpy(textureData, finalData.GetData(), textureDataSize);
+        FMemory::Memcpy(textureData, data.GetData(), textureDataSize);
         texmip->BulkData.Unlock();
 
         texture->MipGenSettings = TMGS_NoMipmaps;
@@ -80,34 +129,562 @@ namespace QuakeCommon
         return texture;
     }
 
-    void CreateUMaterial(const FString& materialName, UPackage& materialPackage, UTexture2D& initialTexture)
+    void UpdateUTexture2D(UTexture2D& texture, int width, int height, const TArray<uint8>& data)
     {
-        if (QuakeCommon::CheckIfAssetExist<UMaterial>(materialName, materialPackage))
+        QUAKE_IMPORT_SCOPE("CreateTexture");
+
+        texture.PreEditChange(NULL);
+        texture.Source.Init(width, height, 1, 1, TSF_BGRA8, data.GetData());
+        texture.MarkPackageDirty();
+        texture.PostEditChange();
+    }
+
+    UTexture2DArray* CreateUTexture2DArray(const FString& name, int width, int height, int numSlices, const TArray<uint8>& data, UPackage& texturePackage, const TArray<QColor>& pal)
+    {
+        QUAKE_IMPORT_SCOPE("CreateTexture");
+
+        FString finalName = name + "_color";
+
+        if (CheckIfAssetExist<UTexture2DArray>(finalName, texturePackage))
         {
-            return;
+            return nullptr;
+        }
+
+        // get colors from palette
+        TArray<uint8> finalData;
+        ExpandPalette(data, pal, finalData);
+
+        // Create Texture
+        UTexture2DArray* texture = NewObject<UTexture2DArray>(&texturePackage, FName(*finalName), RF_Public | RF_Standalone);
+
+        ImportSession::Root(*texture);
+        texture->MipGenSettings = TMGS_NoMipmaps;
+        texture->Source.Init(width, height, numSlices, 1, TSF_BGRA8, finalData.GetData());
+
+        FAssetRegistryModule::AssetCreated(texture);
+
+        texture->UpdateResource();
+        texturePackage.MarkPackageDirty();
+
+        return texture;
+    }
+
+    static const TCHAR* MASTER_MATERIAL_PATH = TEXT("/Game/Textures/Masters");
+    static const TCHAR* TEXTURE_PARAMETER = TEXT("Texture");
+    static const TCHAR* NUM_FRAMES_PARAMETER = TEXT("NumFrames");
+
+    // Bumped when BuildMasterGraph changes, masters saved by an older version are rebuilt
+    static const uint64 MASTER_GRAPH_VERSION = 3;
+
+    namespace
+    {
+        template<typename T>
+        T* AddExpression(UMaterial& material)
+        {
+            T* expression = NewObject<T>(&material);
+            material.GetExpressionCollection().AddExpression(expression);
+            return expression;
         }
 
-        UMaterialFactoryNew* materialFactory = NewObject<UMaterialFactoryNew>();
-        materialFactory->AddToRoot();
+        template<typename T>
+        T* AddMath(UMaterial& material, UMaterialExpression* a, UMaterialExpression* b)
+        {
+            T* expression = AddExpression<T>(material);
+            expression->A.Connect(0, a);
+            expression->B.Connect(0, b);
+            return expression;
+        }
+
+        template<typename T>
+        T* AddMath(UMaterial& material, UMaterialExpression* a, float b)
+        {
+            T* expression = AddExpression<T>(material);
+            expression->A.Connect(0, a);
+            expression->ConstB = b;
+            return expression;
+        }
+
+        UMaterialExpressionComponentMask* AddMask(UMaterial& material, UMaterialExpression* input, bool r, bool g)
+        {
+            UMaterialExpressionComponentMask* mask = AddExpression<UMaterialExpressionComponentMask>(material);
+            mask->Input.Connect(0, input);
+            mask->R = r;
+            mask->G = g;
+            mask->B = false;
+            mask->A = false;
+            return mask;
+        }
+
+        UMaterialExpressionAppendVector* AddAppend(UMaterial& material, UMaterialExpression* a, UMaterialExpression* b)
+        {
+            UMaterialExpressionAppendVector* append = AddExpression<UMaterialExpressionAppendVector>(material);
+            append->A.Connect(0, a);
+            append->B.Connect(0, b);
+            return append;
+        }
+
+        // Frames stacked vertically, stepped at 10 per second like the Quake renderer
+        UMaterialExpression* AddFlipbookCoordinates(UMaterial& material)
+        {
+            UMaterialExpressionTextureCoordinate* texcoord = AddExpression<UMaterialExpressionTextureCoordinate>(material);
+            UMaterialExpressionTime* time = AddExpression<UMaterialExpressionTime>(material);
+
+            UMaterialExpressionScalarParameter* numFrames = AddExpression<UMaterialExpressionScalarParameter>(material);
+            numFrames->ParameterName = NUM_FRAMES_PARAMETER;
+            numFrames->Group = TEXT("Quake");
+            numFrames->DefaultValue = 1.0f;
+
+            UMaterialExpressionFloor* frame = AddExpression<UMaterialExpressionFloor>(material);
+            frame->Input.Connect(0, AddMath<UMaterialExpressionMultiply>(material, time, 10.0f));
+
+            UMaterialExpressionFrac* tileV = AddExpression<UMaterialExpressionFrac>(material);
+            tileV->Input.Connect(0, AddMask(material, texcoord, false, true));
+
+            // frac((frac(v) + frame) / numFrames) wraps the frame index too
+            UMaterialExpressionAdd* stackV = AddMath<UMaterialExpressionAdd>(material, tileV, frame);
+            UMaterialExpressionFrac* v = AddExpression<UMaterialExpressionFrac>(material);
+            v->Input.Connect(0, AddMath<UMaterialExpressionDivide>(material, stackV, numFrames));
+
+            return AddAppend(material, AddMask(material, texcoord, true, false), v);
+        }
+
+        // Quake warp, each axis offset by 8 texels * sin(other axis * 0.125 + time) on a 64 texel tile
+        UMaterialExpression* AddTurbulentCoordinates(UMaterial& material)
+        {
+            UMaterialExpressionTextureCoordinate* texcoord = AddExpression<UMaterialExpressionTextureCoordinate>(material);
+            UMaterialExpressionTime* time = AddExpression<UMaterialExpressionTime>(material);
+
+            UMaterialExpression* axes[2] = { AddMask(material, texcoord, true, false), AddMask(material, texcoord, false, true) };
+            UMaterialExpression* warped[2];
+
+            for (int i = 0; i < 2; i++)
+            {
+                UMaterialExpressionSine* wave = AddExpression<UMaterialExpressionSine>(material);
+                wave->Period = UE_TWO_PI;
+                wave->Input.Connect(0, AddMath<UMaterialExpressionAdd>(material, AddMath<UMaterialExpressionMultiply>(material, axes[1 - i], 8.0f), time));
+
+                warped[i] = AddMath<UMaterialExpressionAdd>(material, axes[i], AddMath<UMaterialExpressionMultiply>(material, wave, 0.125f));
+            }
+
+            return AddAppend(material, warped[0], warped[1]);
+        }
+
+        // Back layer scrolls 8 texels per second on a 128 texel tile
+        UMaterialExpression* AddSkyCoordinates(UMaterial& material)
+        {
+            UMaterialExpressionPanner* panner = AddExpression<UMaterialExpressionPanner>(material);
+            panner->SpeedX = 1.0f / 16.0f;
+            panner->SpeedY = 1.0f / 16.0f;
+            return panner;
+        }
+
+        UMaterialExpressionScalarParameter* AddScalarParameter(UMaterial& material, const TCHAR* name, float value)
+        {
+            UMaterialExpressionScalarParameter* parameter = AddExpression<UMaterialExpressionScalarParameter>(material);
+            parameter->ParameterName = name;
+            parameter->Group = TEXT("Quake");
+            parameter->DefaultValue = value;
+            return parameter;
+        }
+
+        UMaterialExpressionVectorParameter* AddVectorParameter(UMaterial& material, const TCHAR* name, const FLinearColor& value)
+        {
+            UMaterialExpressionVectorParameter* parameter = AddExpression<UMaterialExpressionVectorParameter>(material);
+            parameter->ParameterName = name;
+            parameter->Group = TEXT("Quake");
+            parameter->DefaultValue = value;
+            return parameter;
+        }
+
+        void AddCustomInput(UMaterialExpressionCustom& custom, const TCHAR* name, UMaterialExpression* input, int32 outputIndex = 0)
+        {
+            FCustomInput& customInput = custom.Inputs.AddDefaulted_GetRef();
+            customInput.InputName = name;
+            customInput.Input.Connect(outputIndex, input);
+        }
+
+        UMaterialExpressionCustom* AddCustom(UMaterial& material, const TCHAR* description, const FString& code, TArrayView<const TPair<const TCHAR*, UMaterialExpression*>> inputs)
+        {
+            UMaterialExpressionCustom* custom = AddExpression<UMaterialExpressionCustom>(material);
+            custom->Description = description;
+            custom->OutputType = CMOT_Float3;
+            custom->Code = code;
+            custom->Inputs.Reset();
+
+            for (const TPair<const TCHAR*, UMaterialExpression*>& input : inputs)
+            {
+                AddCustomInput(*custom, input.Key, input.Value);
+            }
+
+            return custom;
+        }
+
+        UMaterialExpressionTransform* AddLocalToWorld(UMaterial& material, UMaterialExpression* input)
+        {
+            UMaterialExpressionTransform* transform = AddExpression<UMaterialExpressionTransform>(material);
+            transform->Input.Connect(0, input);
+            transform->TransformSourceType = TRANSFORMSOURCE_Local;
+            transform->TransformType = TRANSFORM_World;
+            return transform;
+        }
+
+        // Texel of vertex UV (channel 1) in poses A and B, see VatLayout::TexelIndex.
+        // Pose n starts poseWidth * (n % poseColumns) texels right and rowsPerPose * (n / poseColumns) rows down.
+        static const TCHAR* VAT_POSE_UV_CODE = TEXT(
+            "float2 poseStep = float2(Tiling.x, Layout.z) / Layout.xy;\n"
+            "float poseA = floor(PoseA);\n"
+            "float poseB = floor(PoseB);\n"
+            "float2 uvA = UV + float2(fmod(poseA, Tiling.y), floor(poseA / Tiling.y)) * poseStep;\n"
+            "float2 uvB = UV + float2(fmod(poseB, Tiling.y), floor(poseB / Tiling.y)) * poseStep;\n");
+
+        // Vertex animation from the VAT textures of the mdl, see SetVatMaterialParameters. The pose
+        // parameters are rows of the _desc table, set per component through a dynamic instance.
+        void AddVatGraph(UMaterial& material, UPackage& package)
+        {
+            // Linear default, a texel decoding to a zero offset and an up normal
+            FString previewName = material.GetName() + "_vat_preview";
+            UTexture2D* previewTexture = CreateUTexture2DFromBGRA(previewName, 1, 1, { 255, 128, 128, 0 }, package);
+
+            if (previewTexture)
+            {
+                previewTexture->SRGB = false;
+                previewTexture->CompressionSettings = TC_VectorDisplacementmap;
+                previewTexture->Filter = TF_Nearest;
+                previewTexture->UpdateResource();
+            }
+            else
+            {
+                previewTexture = (UTexture2D*)CheckIfAssetExist<UTexture2D>(previewName + "_color", package);
+            }
+
+            UMaterialExpressionTextureObjectParameter* textures[2];
+            const TCHAR* textureNames[2] = { TEXT("VatAnimation"), TEXT("VatNormal") };
+
+            for (int i = 0; i < 2; i++)
+            {
+                textures[i] = AddExpression<UMaterialExpressionTextureObjectParameter>(material);
+                textures[i]->ParameterName = textureNames[i];
+                textures[i]->Group = TEXT("Quake");
+                textures[i]->Texture = previewTexture;
+                textures[i]->SamplerType = SAMPLERTYPE_LinearColor;
+            }
+
+            UMaterialExpressionTextureCoordinate* uv = AddExpression<UMaterialExpressionTextureCoordinate>(material);
+            uv->CoordinateIndex = 1;
+
+            // Zero scale until an import sets the parameters, the preview then stays in its bind pose
+            UMaterialExpressionVectorParameter* layout = AddVectorParameter(material, TEXT("VatLayout"), FLinearColor(1.0f, 1.0f, 1.0f, 0.0f));
+            UMaterialExpressionVectorParameter* tiling = AddVectorParameter(material, TEXT("VatPoseTiling"), FLinearColor(1.0f, 1.0f, 0.0f, 0.0f));
+            UMaterialExpressionVectorParameter* scale = AddVectorParameter(material, TEXT("VatScale"), FLinearColor(0.0f, 0.0f, 0.0f, 0.0f));
+            UMaterialExpressionVectorParameter* origin = AddVectorParameter(material, TEXT("VatOrigin"), FLinearColor(0.0f, 0.0f, 0.0f, 0.0f));
+
+            TPair<const TCHAR*, UMaterialExpression*> poseInputs[] = {
+                { TEXT("UV"), uv },
+                { TEXT("PoseA"), AddScalarParameter(material, TEXT("VatPoseA"), 0.0f) },
+                { TEXT("PoseB"), AddScalarParameter(material, TEXT("VatPoseB"), 0.0f) },
+                { TEXT("Blend"), AddScalarParameter(material, TEXT("VatBlend"), 0.0f) },
+                { TEXT("Layout"), layout },
+                { TEXT("Tiling"), tiling },
+                { TEXT("Anim"), textures[0] },
+            };
+
+            // position = texel * VatScale + VatOrigin. Float16Delta texels are offsets from the mesh,
+            // quantized texels are absolute positions and VatScale.w = 1 removes the mesh position.
+            UMaterialExpressionCustom* position = AddCustom(material, TEXT("VatPosition"),
+                FString(VAT_POSE_UV_CODE) +
+                TEXT("float3 texel = lerp(Texture2DSampleLevel(Anim, AnimSampler, uvA, 0).xyz, Texture2DSampleLevel(Anim, AnimSampler, uvB, 0).xyz, Blend);\n")
+                TEXT("return texel * Scale + Origin - Local * Absolute;\n"),
+                poseInputs);
+
+            AddCustomInput(*position, TEXT("Scale"), scale);
+            AddCustomInput(*position, TEXT("Absolute"), scale, 4); // alpha output of the vector parameter
+            AddCustomInput(*position, TEXT("Origin"), origin);
+            AddCustomInput(*position, TEXT("Local"), AddExpression<UMaterialExpressionPreSkinnedPosition>(material));
+
+            // Normals are stored like the positions, 0-1 texels of the unit vector. With VatPackedNormals
+            // the animation alpha holds the light normal index and VatNormal is the 256x1 table it addresses.
+            UMaterialExpressionCustom* normal = AddCustom(material, TEXT("VatNormal"),
+                FString(VAT_POSE_UV_CODE) +
+                TEXT("if (Packed > 0.5)\n")
+                TEXT("{\n")
+                TEXT("    uvA = float2((Texture2DSampleLevel(Anim, AnimSampler, uvA, 0).a * 255 + 0.5) / 256, 0.5);\n")
+                TEXT("    uvB = float2((Texture2DSampleLevel(Anim, AnimSampler, uvB, 0).a * 255 + 0.5) / 256, 0.5);\n")
+                TEXT("}\n")
+                TEXT("float3 texel = lerp(Texture2DSampleLevel(Normals, NormalsSampler, uvA, 0).xyz, Texture2DSampleLevel(Normals, NormalsSampler, uvB, 0).xyz, Blend);\n")
+                TEXT("return normalize(texel * 2 - 1);\n"),
+                poseInputs);
+
+            AddCustomInput(*normal, TEXT("Normals"), textures[1]);
+            AddCustomInput(*normal, TEXT("Packed"), AddScalarParameter(material, TEXT("VatPackedNormals"), 0.0f));
+
+            material.GetEditorOnlyData()->WorldPositionOffset.Connect(0, AddLocalToWorld(material, position));
+
+            // Decoded in the vertex shader, the pixel shader gets the interpolated world normal
+            UMaterialExpressionVertexInterpolator* interpolator = AddExpression<UMaterialExpressionVertexInterpolator>(material);
+            interpolator->VSOutput.Connect(0, AddLocalToWorld(material, normal));
+
+            material.GetEditorOnlyData()->Normal.Connect(0, interpolator);
+            material.bTangentSpaceNormal = false;
+        }
+
+        void BuildMasterGraph(UMaterial& material, EQuakeMaterial surface, UPackage& package)
+        {
+            // Texture parameters need a default, a grey texel kept next to the material
+            const TArray<QColor> grey = { { 128, 128, 128 } };
+            const TArray<uint8> texel = { 0 };
+            FString previewName = material.GetName() + "_preview";
+            UTexture* previewTexture = nullptr;
+
+            UMaterialExpression* coordinates = nullptr;
+            UMaterialExpressionTextureSampleParameter* sample = nullptr;
+
+            if (surface == EQuakeMaterial::AliasArray)
+            {
+                // Sample the array with (uv0, SkinFrame)
+                UMaterialExpressionScalarParameter* frame = AddExpression<UMaterialExpressionScalarParameter>(material);
+                frame->ParameterName = TEXT("SkinFrame");
+                frame->Group = TEXT("Quake");
 
-        materialFactory->InitialTexture = &initialTexture;
+                coordinates = AddAppend(material, AddExpression<UMaterialExpressionTextureCoordinate>(material), frame);
+                sample = AddExpression<UMaterialExpressionTextureSampleParameter2DArray>(material);
+                previewTexture = CreateUTexture2DArray(previewName, 1, 1, 1, texel, package, grey);
+            }
+            else
+            {
+                switch (surface)
+                {
+                case EQuakeMaterial::Sky:       coordinates = AddSkyCoordinates(material); break;
+                case EQuakeMaterial::Flipbook:  coordinates = AddFlipbookCoordinates(material); break;
+                case EQuakeMaterial::Liquid:    coordinates = AddTurbulentCoordinates(material); break;
+                default:                        break;
+                }
 
-        UMaterial* material = (UMaterial*)materialFactory->FactoryCreateNew(UMaterial::StaticClass(), &materialPackage, *materialName, RF_Standalone | RF_Public, NULL, GWarn);
+                sample = AddExpression<UMaterialExpressionTextureSampleParameter2D>(material);
+                previewTexture = CreateUTexture2D(previewName, 1, 1, texel, package, grey);
+            }
 
-        UMaterialExpressionConstant* specValue = NewObject<UMaterialExpressionConstant>(material);
-        material->AddToRoot();
-        material->GetEditorOnlyData()->Specular.Connect(0, specValue);
+            if (!previewTexture)
+            {
+                previewTexture = (UTexture*)CheckIfAssetExist<UTexture>(previewName + "_color", package);
+            }
 
-        FAssetRegistryModule::AssetCreated(material);
+            sample->ParameterName = TEXTURE_PARAMETER;
+            sample->Group = TEXT("Quake");
+            sample->Texture = previewTexture;
+            sample->SamplerType = SAMPLERTYPE_Color;
+
+            if (coordinates)
+            {
+                sample->Coordinates.Connect(0, coordinates);
+            }
+
+            if (surface == EQuakeMaterial::Alias || surface == EQuakeMaterial::AliasArray)
+            {
+                AddVatGraph(material, package);
+            }
+
+            // Sky and liquids are fullbright in Quake
+            if (surface == EQuakeMaterial::Sky || surface == EQuakeMaterial::Liquid)
+            {
+                material.SetShadingModel(MSM_Unlit);
+                material.GetEditorOnlyData()->EmissiveColor.Connect(0, sample);
+            }
+            else
+            {
+                material.GetEditorOnlyData()->BaseColor.Connect(0, sample);
+                material.GetEditorOnlyData()->Specular.Connect(0, AddExpression<UMaterialExpressionConstant>(material));
+            }
+        }
+    }
+
+    static FString GetMasterMaterialPackageName(EQuakeMaterial surface)
+    {
+        static const TCHAR* names[] = { TEXT("M_QuakeOpaque"), TEXT("M_QuakeSky"), TEXT("M_QuakeFlipbook"), TEXT("M_QuakeLiquid"), TEXT("M_QuakeAlias"), TEXT("M_QuakeAliasArray") };
+        static_assert(UE_ARRAY_COUNT(names) == (int)EQuakeMaterial::Count, "One master material name per surface class");
+
+        return FString(MASTER_MATERIAL_PATH) / names[(int)surface];
+    }
+
+    UMaterial* GetMasterMaterial(EQuakeMaterial surface)
+    {
+        FString packageName = GetMasterMaterialPackageName(surface);
+        FString materialName = FPackageName::GetShortName(packageName);
+
+        UMaterial* material = LoadObject<UMaterial>(nullptr, *(packageName + TEXT(".") + materialName), nullptr, LOAD_Quiet | LOAD_NoWarn);
+
+        if (material && IsImportHashCurrent(*material, MASTER_GRAPH_VERSION))
+        {
+            return material;
+        }
+
+        QUAKE_IMPORT_SCOPE("CreateMasterMaterial");
+
+        UPackage* package = nullptr;
+
+        if (material)
+        {
+            // Rebuilt in place, the instances of every import keep their parent
+            package = material->GetOutermost();
+            material->PreEditChange(NULL);
+            material->GetExpressionCollection().Empty();
+
+            UMaterialEditorOnlyData* editorData = material->GetEditorOnlyData();
+            editorData->BaseColor.Expression = nullptr;
+            editorData->EmissiveColor.Expression = nullptr;
+            editorData->Specular.Expression = nullptr;
+            editorData->Normal.Expression = nullptr;
+            editorData->WorldPositionOffset.Expression = nullptr;
+            material->SetShadingModel(MSM_DefaultLit);
+            material->bTangentSpaceNormal = true;
+        }
+        else
+        {
+            package = CreatePackage(nullptr, *packageName);
+            material = NewObject<UMaterial>(package, *materialName, RF_Standalone | RF_Public);
+            ImportSession::Root(*material);
+            FAssetRegistryModule::AssetCreated(material);
+        }
+
+        BuildMasterGraph(*material, surface, *package);
+        SetImportHash(*material, MASTER_GRAPH_VERSION);
 
-        material->PreEditChange(NULL);
-        material->MarkPackageDirty();
-        materialPackage.SetDirtyFlag(true);
         material->PostEditChange();
+        package->MarkPackageDirty();
+
+        // Shared by every import, saved now instead of with the packages of the current one
+        SavePackage(*package);
+
+        return material;
+    }
+
+    void CreateMasterMaterials()
+    {
+        ImportSession session;
+
+        for (int i = 0; i < (int)EQuakeMaterial::Count; i++)
+        {
+            GetMasterMaterial((EQuakeMaterial)i);
+        }
+    }
+
+    UMaterialInterface* CreateUMaterial(const FString& materialName, UPackage& materialPackage, UTexture& texture, EQuakeMaterial surface, int numFrames)
+    {
+        QUAKE_IMPORT_SCOPE("CreateMaterial");
+
+        if (UMaterialInterface* existing = (UMaterialInterface*)QuakeCommon::CheckIfAssetExist<UMaterialInterface>(materialName, materialPackage))
+        {
+            // Flipbooks can gain or lose frames between imports
+            UMaterialInstanceConstant* instance = Cast<UMaterialInstanceConstant>(existing);
+            float existingFrames = 0.0f;
+
+            if (instance && surface == EQuakeMaterial::Flipbook &&
+                instance->GetScalarParameterValue(FHashedMaterialParameterInfo(NUM_FRAMES_PARAMETER), existingFrames) && existingFrames != numFrames)
+            {
+                instance->SetScalarParameterValueEditorOnly(FMaterialParameterInfo(NUM_FRAMES_PARAMETER), numFrames);
+                instance->MarkPackageDirty();
+            }
+
+            return existing;
+        }
+
+        UMaterial* master = GetMasterMaterial(surface);
+
+        UMaterialInstanceConstant* instance = NewObject<UMaterialInstanceConstant>(&materialPackage, *materialName, RF_Standalone | RF_Public);
+        ImportSession::Root(*instance);
+
+        instance->SetParentEditorOnly(master);
+        instance->SetTextureParameterValueEditorOnly(FMaterialParameterInfo(TEXTURE_PARAMETER), &texture);
+
+        if (surface == EQuakeMaterial::Flipbook)
+        {
+            instance->SetScalarParameterValueEditorOnly(FMaterialParameterInfo(NUM_FRAMES_PARAMETER), numFrames);
+        }
+
+        FAssetRegistryModule::AssetCreated(instance);
+
+        instance->PostEditChange();
+        instance->MarkPackageDirty();
+
+        return instance;
+    }
+
+    void SetMaterialVectorParameters(UMaterialInterface& material, TArrayView<const TPair<FName, FLinearColor>> values)
+    {
+        if (UMaterialInstanceConstant* instance = Cast<UMaterialInstanceConstant>(&material))
+        {
+            for (const TPair<FName, FLinearColor>& value : values)
+            {
+                instance->SetVectorParameterValueEditorOnly(FMaterialParameterInfo(value.Key), value.Value);
+            }
+
+            instance->MarkPackageDirty();
+            return;
+        }
+
+        // Standalone material from an import before master materials
+        UMaterial* graph = Cast<UMaterial>(&material);
+
+        if (!graph)
+        {
+            return;
+        }
+
+        // PostEditChange recompiles the material, once for every parameter
+        graph->PreEditChange(NULL);
+
+        for (const TPair<FName, FLinearColor>& value : values)
+        {
+            UMaterialExpressionVectorParameter* parameter = nullptr;
+
+            for (UMaterialExpression* expression : graph->GetExpressions())
+            {
+                UMaterialExpressionVectorParameter* vectorParameter = Cast<UMaterialExpressionVectorParameter>(expression);
+
+                if (vectorParameter && vectorParameter->ParameterName == value.Key)
+                {
+                    parameter = vectorParameter;
+                    break;
+                }
+            }
+
+            if (!parameter)
+            {
+                parameter = NewObject<UMaterialExpressionVectorParameter>(graph);
+                parameter->ParameterName = value.Key;
+                parameter->Group = TEXT("Quake");
+                graph->GetExpressionCollection().AddExpression(parameter);
+            }
+
+            parameter->DefaultValue = value.Value;
+        }
+
+        graph->MarkPackageDirty();
+        graph->PostEditChange();
+    }
+
+    void SetMaterialTextureParameter(UMaterialInterface& material, const FName& name, UTexture& value)
+    {
+        // Standalone materials from an import before master materials have no graph to bind it to
+        if (UMaterialInstanceConstant* instance = Cast<UMaterialInstanceConstant>(&material))
+        {
+            instance->SetTextureParameterValueEditorOnly(FMaterialParameterInfo(name), &value);
+            instance->MarkPackageDirty();
+        }
+    }
+
+    void SetMaterialScalarParameter(UMaterialInterface& material, const FName& name, float value)
+    {
+        if (UMaterialInstanceConstant* instance = Cast<UMaterialInstanceConstant>(&material))
+        {
+            instance->SetScalarParameterValueEditorOnly(FMaterialParameterInfo(name), value);
+            instance->MarkPackageDirty();
+        }
     }
 
     void SaveAsset(UObject& object, UPackage& package)
     {
+        QUAKE_IMPORT_SCOPE("SavePackage");
+
         UPackage::SavePackage(
             &package,
             &object,
@@ -121,8 +698,25 @@ namespace QuakeCommon
         );
     }
 
+    static const TCHAR* IMPORT_HASH_KEY = TEXT("QuakeImportHash");
+
+    bool IsImportHashCurrent(const UObject& object, uint64 hash)
+    {
+        UMetaData* metaData = object.GetOutermost()->GetMetaData();
+        return metaData->GetValue(&object, IMPORT_HASH_KEY) == FString::Printf(TEXT("%016llx"), hash);
+    }
+
+    void SetImportHash(UObject& object, uint64 hash)
+    {
+        UMetaData* metaData = object.GetOutermost()->GetMetaData();
+        metaData->SetValue(&object, IMPORT_HASH_KEY, *FString::Printf(TEXT("%016llx"), hash));
+        object.MarkPackageDirty();
+    }
+
     void SavePackage(UPackage& package)
     {
+        QUAKE_IMPORT_SCOPE("SavePackage");
+
         UPackage::SavePackage(
             &package,
             nullptr,
@@ -136,4 +730,61 @@ namespace QuakeCommon
         );
     }
 
+    ImportPackages::ImportPackages(const FString& sharedPackageName) :
+        m_sharedPackageName(sharedPackageName),
+        m_perAsset(GetDefault<UQuakeImportSettings>()->PackageLayout == EQuakePackageLayout::OneAssetPerPackage)
+    {
+        /* do nothing */
+    }
+
+    FString ImportPackages::GetPackageName(const FString& assetName) const
+    {
+        if (!m_perAsset)
+        {
+            return m_sharedPackageName;
+        }
+
+        // Quake names like *water0 are valid object names but not package names
+        FString shortName = assetName;
+
+        for (const TCHAR* c = INVALID_LONGPACKAGE_CHARACTERS; *c; c++)
+        {
+            shortName.ReplaceCharInline(*c, TEXT('_'));
+        }
+
+        return FPackageName::GetLongPackagePath(m_sharedPackageName) / shortName;
+    }
+
+    UPackage& ImportPackages::ForAsset(const FString& assetName)
+    {
+        FString packageName = GetPackageName(assetName);
+
+        if (UPackage** package = m_packages.Find(packageName))
+        {
+            return **package;
+        }
+
+        UPackage* package = CreatePackage(nullptr, *packageName);
+        m_packages.Add(packageName, package);
+        return *package;
+    }
+
+    static TSet<FString> GForeignPackages;
+
+    void SetForeignPackages(const TSet<FString>& packageNames)
+    {
+        GForeignPackages = packageNames;
+    }
+
+    void ImportPackages::SaveDirty()
+    {
+        for (const auto& it : m_packages)
+        {
+            if (it.Value->IsDirty() && !GForeignPackages.Contains(it.Key))
+            {
+                SavePackage(*it.Value);
+            }
+        }
+    }
+
 } // namespace QuakeCommon
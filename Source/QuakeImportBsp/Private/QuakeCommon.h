@@ -2,7 +2,11 @@
 
 #include "CoreMinimal.h"
 
+class UMaterial;
+class UMaterialInterface;
+class UTexture;
 class UTexture2D;
+class UTexture2DArray;
 class UPackage;
 
 namespace QuakeCommon
@@ -18,11 +22,50 @@ namespace QuakeCommon
     // Load Quake color palette from file in our plugin content
     bool LoadPalette(TArray<QColor>& outPalette);
 
+    // Convert 8 bit palette indices to BGRA8. Pixels using transparentIndex get a 0 alpha.
+    void ExpandPalette(const TArray<uint8>& data, const TArray<QColor>& pal, TArray<uint8>& out, int transparentIndex = -1);
+
     // Create a UTexture2D in the given package then save
     UTexture2D* CreateUTexture2D(const FString& name, int width, int height, const TArray<uint8>& data, UPackage& texturePackage, const TArray<QColor>& pal, bool savePackage = true);
 
-    // Create matching material for texture
-    void CreateUMaterial(const FString& textureName, UPackage& materialPackage, UTexture2D& initialTexture);
+    // Create a UTexture2D from BGRA8 pixels already converted with ExpandPalette
+    UTexture2D* CreateUTexture2DFromBGRA(const FString& name, int width, int height, const TArray<uint8>& data, UPackage& texturePackage);
+
+    // Replace the source pixels of a previously imported texture with new BGRA8 pixels
+    void UpdateUTexture2D(UTexture2D& texture, int width, int height, const TArray<uint8>& data);
+
+    // Create a UTexture2DArray from numSlices images stored back to back in data
+    UTexture2DArray* CreateUTexture2DArray(const FString& name, int width, int height, int numSlices, const TArray<uint8>& data, UPackage& texturePackage, const TArray<QColor>& pal);
+
+    // Surface classes sharing a master material. Imported textures get an instance of one of them.
+    enum class EQuakeMaterial : uint8
+    {
+        Opaque,         // lit walls and floors
+        Sky,            // unlit, scrolling
+        Flipbook,       // lit, +0 animated textures with the frames stacked vertically
+        Liquid,         // unlit, turbulent warp of the * textures
+        Alias,          // lit, with the VAT parameters of alias models
+        AliasArray,     // Alias sampling the texture array slice picked by the SkinFrame parameter
+        Count
+    };
+
+    // Load the master material of a surface class, or create and save it
+    UMaterial* GetMasterMaterial(EQuakeMaterial surface);
+
+    // Create and save every missing master material, before import workers start instancing them
+    void CreateMasterMaterials();
+
+    // Create a material instance of the surface class master sampling texture. numFrames is for flipbooks.
+    // Returns the existing material if already imported.
+    UMaterialInterface* CreateUMaterial(const FString& materialName, UPackage& materialPackage, UTexture& texture, EQuakeMaterial surface, int numFrames = 1);
+
+    // Set named vector parameters on a material instance, or add them to the graph of a standalone material.
+    // A standalone material is edited and recompiled once for the whole batch.
+    void SetMaterialVectorParameters(UMaterialInterface& material, TArrayView<const TPair<FName, FLinearColor>> values);
+
+    // Set a named texture or scalar parameter on a material instance
+    void SetMaterialTextureParameter(UMaterialInterface& material, const FName& name, UTexture& value);
+    void SetMaterialScalarParameter(UMaterialInterface& material, const FName& name, float value);
 
     // Utilities
 
@@ -42,6 +85,37 @@ namespace QuakeCommon
 
     void SaveAsset(UObject& object, UPackage& package);
 
+    // Content hash of the source data an asset was imported from, kept in the package metadata
+    // so a reimport can skip assets whose source did not change
+    bool IsImportHashCurrent(const UObject& object, uint64 hash);
+    void SetImportHash(UObject& object, uint64 hash);
+
     void SavePackage(UPackage& package);
 
+    // Packages for a group of imported assets following the project package layout.
+    // Shared layout returns the same package for every asset, per asset layout
+    // creates one package per asset next to it.
+    class ImportPackages
+    {
+    public:
+        ImportPackages(const FString& sharedPackageName);
+
+        UPackage& ForAsset(const FString& assetName);
+
+        // Name of the package ForAsset returns for this asset
+        FString GetPackageName(const FString& assetName) const;
+
+        // Save packages created or modified during this import
+        void SaveDirty();
+
+    private:
+        FString                 m_sharedPackageName;
+        bool                    m_perAsset;
+        TMap<FString, UPackage*> m_packages;
+    };
+
+    // Packages another import process owns, used by batch import workers.
+    // SaveDirty never saves them so every package has a single writer.
+    void SetForeignPackages(const TSet<FString>& packageNames);
+
 } // namespace QuakeCommon
\ No newline at end of file
@@ -0,0 +1,771 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "QuakeImportBenchmarkCommandlet.h"
+
+// Epic
+#include "Async/Async.h"
+#include "Dom/JsonObject.h"
+#include "Engine/World.h"
+#include "HAL/PlatformMemory.h"
+#include "Math/RandomStream.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RawMesh/Public/RawMesh.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+#include <atomic>
+
+// Quake Import
+#include "Alias.h"
+#include "AliasPoseReduction.h"
+#include "AliasVat.h"
+#include "BspFactory.h"
+#include "BspHulls.h"
+#include "BspLightmap.h"
+#include "BspUtilities.h"
+#include "BspVisibility.h"
+#include "EntityMaker.h"
+#include "QuakeCommon.h"
+#include "QuakeImportSettings.h"
+
+namespace
+{
+    using namespace bsputils;
+
+    // Size of the 1x data, roughly e1m1 and player.mdl
+    constexpr int BASE_BSP_FACES = 4000;
+    constexpr int BASE_BSP_TEXTURES = 8;
+    constexpr int BASE_ENTITIES = 300;
+    constexpr int BASE_MDL_VERTS = 300;
+    constexpr int BASE_MDL_TRIS = 500;
+    constexpr int MDL_FRAMES = 200;
+
+    // Vertex grid shared by every synthetic face. Edges index vertices with a short.
+    constexpr int BSP_GRID = 128;
+    constexpr int BSP_TEXTURE_SIZE = 64;
+    constexpr float BSP_EXTENT = BSP_GRID * 64.0f;
+
+    // Marksurfaces index faces with an unsigned short, the world model can't hold more
+    constexpr int MAX_WORLD_FACES = 0xFFFF;
+
+    // Alternating solid and empty slabs along x in the player hull, so the hull regions grow with the scale
+    constexpr int BASE_CLIP_SLABS = 16;
+    constexpr int MAX_CLIP_SLABS = 4096;
+    constexpr int MDL_SKIN_SIZE = 64;
+
+    constexpr int32 RANDOM_SEED = 0x51AE;
+
+    template<typename T>
+    void AppendPod(TArray<uint8>& out, const T& value)
+    {
+        out.Append(reinterpret_cast<const uint8*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void AppendLump(TArray<uint8>& out, bspformat29::Header& header, int lump, const TArray<T>& data)
+    {
+        header.lumps[lump].position = out.Num();
+        header.lumps[lump].length = data.Num() * sizeof(T);
+        out.Append(reinterpret_cast<const uint8*>(data.GetData()), data.Num() * sizeof(T));
+    }
+
+    FString GenerateEntities(int numEntities, FRandomStream& random)
+    {
+        FString out = TEXT("{\n\"classname\" \"worldspawn\"\n\"message\" \"benchmark\"\n}\n");
+        out += TEXT("{\n\"classname\" \"info_player_start\"\n\"origin\" \"0 0 24\"\n\"angle\" \"90\"\n}\n");
+
+        for (int i = 0; i < numEntities; i++)
+        {
+            out += FString::Printf(
+                TEXT("{\n\"classname\" \"light\"\n\"origin\" \"%d %d %d\"\n\"light\" \"%d\"\n}\n"),
+                random.RandRange(-4096, 4096), random.RandRange(-4096, 4096), random.RandRange(-512, 512), random.RandRange(100, 400));
+        }
+
+        return out;
+    }
+
+    // Balanced clip node tree over slabs [first, last) of the x axis, returns the child index of the subtree
+    short GenerateClipSlabs(int first, int last, float slabWidth, TArray<bspformat29::ClipNode>& clipnodes)
+    {
+        if (last - first == 1)
+        {
+            return (short)(first % 2 == 0 ? ELeafContentType::Solid : ELeafContentType::Empty);
+        }
+
+        int middle = (first + last) / 2;
+        int index = clipnodes.Add({ 0, { 0, 0 } });
+
+        clipnodes[index].planenum = 2 + middle; // plane x = middle * slabWidth
+        clipnodes[index].children[1] = GenerateClipSlabs(first, middle, slabWidth, clipnodes);
+        clipnodes[index].children[0] = GenerateClipSlabs(middle, last, slabWidth, clipnodes);
+
+        return (short)index;
+    }
+
+    // Quads over a flat vertex grid, one world model and one brush model per scale step.
+    // The world is a single open leaf above a solid floor holding every world face, with visdata
+    // so hidden surface removal keeps them all, and a player hull of solid slabs.
+    void GenerateBsp(int scale, FRandomStream& random, TArray<uint8>& out)
+    {
+        int numFaces = BASE_BSP_FACES * scale;
+        int numTextures = BASE_BSP_TEXTURES * scale;
+        int numSubmodels = 1 + scale;
+        int numWorldFaces = FMath::Min(numFaces / 2, MAX_WORLD_FACES);
+        int numSlabs = FMath::Min(BASE_CLIP_SLABS * scale, MAX_CLIP_SLABS);
+        float slabWidth = BSP_EXTENT / numSlabs;
+
+        TArray<bspformat29::Point3f> vertices;
+
+        for (int y = 0; y <= BSP_GRID; y++)
+        {
+            for (int x = 0; x <= BSP_GRID; x++)
+            {
+                vertices.Add({ x * 64.0f, y * 64.0f, random.FRandRange(-8.0f, 8.0f) });
+            }
+        }
+
+        TArray<bspformat29::Plane> planes;
+        planes.Add({ { 0.0f, 0.0f, 1.0f }, 0.0f, 2 });     // faces
+        planes.Add({ { 0.0f, 0.0f, 1.0f }, -64.0f, 2 });   // floor
+
+        for (int i = 0; i < numSlabs; i++)
+        {
+            planes.Add({ { 1.0f, 0.0f, 0.0f }, i * slabWidth, 0 });
+        }
+
+        TArray<bspformat29::TexInfo> texinfos;
+
+        for (int i = 0; i < numTextures; i++)
+        {
+            bspformat29::TexInfo ti = {};
+            ti.vecs[0][0] = 1.0f;
+            ti.vecs[1][1] = 1.0f;
+            ti.miptex = i;
+            texinfos.Add(ti);
+        }
+
+        TArray<bspformat29::Edge> edges;
+        TArray<bspformat29::Surfedge> surfedges;
+        TArray<bspformat29::Face> faces;
+
+        edges.Add({ 0, 0 }); // edge 0 is never referenced, its sign would be lost
+
+        for (int i = 0; i < numFaces; i++)
+        {
+            int cell = i % (BSP_GRID * BSP_GRID);
+            int x = cell % BSP_GRID;
+            int y = cell / BSP_GRID;
+
+            short corners[4] = {
+                (short)(y * (BSP_GRID + 1) + x),
+                (short)(y * (BSP_GRID + 1) + x + 1),
+                (short)((y + 1) * (BSP_GRID + 1) + x + 1),
+                (short)((y + 1) * (BSP_GRID + 1) + x)
+            };
+
+            bspformat29::Face face = {};
+            face.planenum = 0;
+            face.side = 0;
+            face.firstedge = surfedges.Num();
+            face.numedges = 4;
+            face.texinfo = random.RandHelper(numTextures);
+            face.lightofs = -1;
+
+            for (int e = 0; e < 4; e++)
+            {
+                surfedges.Add({ edges.Num() });
+                edges.Add({ corners[e], corners[(e + 1) % 4] });
+            }
+
+            faces.Add(face);
+        }
+
+        // Leaf 0 is the shared solid leaf under the floor, leaf 1 the open space above it
+        TArray<bspformat29::Node> nodes;
+        bspformat29::Node node = {};
+        node.planenum = 1;
+        node.children[0] = -2;  // leaf 1
+        node.children[1] = -1;  // leaf 0
+        node.mins[2] = -128;
+        node.maxs[0] = node.maxs[1] = (short)BSP_EXTENT;
+        node.maxs[2] = 64;
+        nodes.Add(node);
+
+        TArray<bspformat29::Leaf> leaves;
+        bspformat29::Leaf solid = {};
+        solid.contents = ELeafContentType::Solid;
+        solid.visofs = -1;
+        leaves.Add(solid);
+
+        bspformat29::Leaf open = {};
+        open.contents = ELeafContentType::Empty;
+        open.visofs = 0;
+        FMemory::Memcpy(open.mins, node.mins, sizeof(open.mins));
+        FMemory::Memcpy(open.maxs, node.maxs, sizeof(open.maxs));
+        open.nummarksurfaces = (unsigned short)numWorldFaces;
+        leaves.Add(open);
+
+        TArray<bspformat29::Marksurface> marksurfaces;
+
+        for (int i = 0; i < numWorldFaces; i++)
+        {
+            marksurfaces.Add({ (short)i });
+        }
+
+        // Leaf 1 sees itself
+        TArray<uint8> visibility = { 0x01 };
+
+        TArray<bspformat29::ClipNode> clipnodes;
+        GenerateClipSlabs(0, numSlabs, slabWidth, clipnodes);
+
+        // World faces first, the rest spread over the brush models
+        TArray<bspformat29::SubModel> submodels;
+        int firstface = 0;
+
+        for (int i = 0; i < numSubmodels; i++)
+        {
+            int count = i == 0 ? numWorldFaces : (numFaces - numWorldFaces) / (numSubmodels - 1);
+
+            if (i == numSubmodels - 1)
+            {
+                count = numFaces - firstface;
+            }
+
+            bspformat29::SubModel submodel = {};
+            submodel.mins[2] = -128.0f;
+            submodel.maxs[0] = submodel.maxs[1] = BSP_EXTENT;
+            submodel.maxs[2] = 64.0f;
+            submodel.visleafs = i == 0 ? 1 : 0;
+            submodel.firstface = firstface;
+            submodel.numfaces = count;
+            submodels.Add(submodel);
+
+            firstface += count;
+        }
+
+        // Textures lump, miptex headers followed by mip0 only
+        TArray<uint8> textures;
+        AppendPod(textures, numTextures);
+
+        int offset = sizeof(int) * (numTextures + 1);
+
+        for (int i = 0; i < numTextures; i++)
+        {
+            AppendPod(textures, offset);
+            offset += sizeof(bspformat29::Miptex) + BSP_TEXTURE_SIZE * BSP_TEXTURE_SIZE;
+        }
+
+        for (int i = 0; i < numTextures; i++)
+        {
+            bspformat29::Miptex mt = {};
+            FCStringAnsi::Snprintf(mt.name, sizeof(mt.name), "bench%d", i);
+            mt.width = BSP_TEXTURE_SIZE;
+            mt.height = BSP_TEXTURE_SIZE;
+            mt.offsets[0] = sizeof(bspformat29::Miptex);
+            AppendPod(textures, mt);
+
+            for (int p = 0; p < BSP_TEXTURE_SIZE * BSP_TEXTURE_SIZE; p++)
+            {
+                textures.Add((uint8)random.RandHelper(256));
+            }
+        }
+
+        TArray<uint8> entities;
+        FTCHARToUTF8 entityText(*GenerateEntities(BASE_ENTITIES * scale, random));
+        entities.Append((const uint8*)entityText.Get(), entityText.Length());
+        entities.Add(0);
+
+        bspformat29::Header header = {};
+        header.version = bspformat29::HEADER_VERSION_29;
+
+        out.Reset();
+        AppendPod(out, header);
+
+        AppendLump(out, header, bspformat29::LUMP_ENTITIES, entities);
+        AppendLump(out, header, bspformat29::LUMP_PLANES, planes);
+        AppendLump(out, header, bspformat29::LUMP_TEXTURES, textures);
+        AppendLump(out, header, bspformat29::LUMP_VERTEXES, vertices);
+        AppendLump(out, header, bspformat29::LUMP_TEXINFO, texinfos);
+        AppendLump(out, header, bspformat29::LUMP_FACES, faces);
+        AppendLump(out, header, bspformat29::LUMP_EDGES, edges);
+        AppendLump(out, header, bspformat29::LUMP_SURFEDGES, surfedges);
+        AppendLump(out, header, bspformat29::LUMP_MODELS, submodels);
+        AppendLump(out, header, bspformat29::LUMP_NODES, nodes);
+        AppendLump(out, header, bspformat29::LUMP_LEAFS, leaves);
+        AppendLump(out, header, bspformat29::LUMP_MARKSURFACES, marksurfaces);
+        AppendLump(out, header, bspformat29::LUMP_VISIBILITY, visibility);
+        AppendLump(out, header, bspformat29::LUMP_CLIPNODES, clipnodes);
+
+        FMemory::Memcpy(out.GetData(), &header, sizeof(header));
+    }
+
+    // Single skin, single frames of a wobbling vertex cloud so pose reduction has something to drop
+    void GenerateMdl(int scale, FRandomStream& random, TArray<uint8>& out)
+    {
+        int numVerts = BASE_MDL_VERTS * scale;
+        int numTris = BASE_MDL_TRIS * scale;
+
+        out.Reset();
+
+        // header, see Alias::AliasHeader
+        AppendPod(out, (int)0x4F504449); // IDPO
+        AppendPod(out, 6);
+        for (int i = 0; i < 3; i++) { AppendPod(out, 0.5f); }           // scale
+        for (int i = 0; i < 3; i++) { AppendPod(out, -64.0f); }         // origin
+        AppendPod(out, 128.0f);                                         // radius
+        for (int i = 0; i < 3; i++) { AppendPod(out, 0.0f); }           // eye position
+        AppendPod(out, 1);                                              // numskins
+        AppendPod(out, MDL_SKIN_SIZE);
+        AppendPod(out, MDL_SKIN_SIZE);
+        AppendPod(out, numVerts);
+        AppendPod(out, numTris);
+        AppendPod(out, MDL_FRAMES);
+        AppendPod(out, 0);                                              // synctype
+        AppendPod(out, 0);                                              // flags
+        AppendPod(out, 1.0f);                                           // size
+
+        AppendPod(out, 0);
+
+        for (int i = 0; i < MDL_SKIN_SIZE * MDL_SKIN_SIZE; i++)
+        {
+            out.Add((uint8)random.RandHelper(256));
+        }
+
+        for (int i = 0; i < numVerts; i++)
+        {
+            AppendPod(out, random.RandHelper(8) == 0 ? 0x20 : 0);       // onseam
+            AppendPod(out, random.RandHelper(MDL_SKIN_SIZE / 2));
+            AppendPod(out, random.RandHelper(MDL_SKIN_SIZE));
+        }
+
+        for (int i = 0; i < numTris; i++)
+        {
+            AppendPod(out, random.RandHelper(2));                       // facesfront
+            for (int c = 0; c < 3; c++) { AppendPod(out, random.RandHelper(numVerts)); }
+        }
+
+        TArray<uint8> base;
+
+        for (int i = 0; i < numVerts * 3; i++)
+        {
+            base.Add((uint8)random.RandRange(32, 223));
+        }
+
+        for (int f = 0; f < MDL_FRAMES; f++)
+        {
+            AppendPod(out, 0);                                          // single frame
+            AppendPod(out, (uint32)0);                                  // bboxmin
+            AppendPod(out, (uint32)0xFFFFFFFF);                         // bboxmax
+
+            char name[16] = {};
+            FCStringAnsi::Snprintf(name, sizeof(name), "frame%d", f);
+            out.Append((const uint8*)name, sizeof(name));
+
+            int wobble = (int)(FMath::Sin(f * 0.2f) * 16.0f);
+
+            for (int v = 0; v < numVerts; v++)
+            {
+                out.Add((uint8)(base[v * 3 + 0] + wobble));
+                out.Add(base[v * 3 + 1]);
+                out.Add(base[v * 3 + 2]);
+                out.Add((uint8)(v % 162));
+            }
+        }
+    }
+
+    /* ==== Measurement ==== */
+
+    struct StageResult
+    {
+        FString name;
+        int     scale;
+        double  seconds;        // best of the iterations
+        int64   bytes;          // input bytes processed per run
+        int64   items;          // faces, vertices, entities... per run
+        uint64  usedPhysical;   // process memory when the stage starts
+        uint64  peakGrowth;     // highest used physical memory during the stage above usedPhysical
+        bool    failed = false; // the stage could not run on the generated input, no timing
+    };
+
+    // Samples the process memory on its own thread while a stage runs. The process wide
+    // PeakUsedPhysical only ever grows, it would report the largest stage run so far.
+    class MemorySampler
+    {
+    public:
+        MemorySampler()
+        {
+            // Hand the pages freed by the previous stages back so they don't hide this one's growth
+            FMemory::Trim();
+
+            m_baseline = FPlatformMemory::GetStats().UsedPhysical;
+            m_peak = m_baseline;
+            m_sampler = Async(EAsyncExecution::Thread, [this]()
+            {
+                while (!m_stop)
+                {
+                    Sample();
+                    FPlatformProcess::Sleep(0.001f);
+                }
+            });
+        }
+
+        void Stop()
+        {
+            m_stop = true;
+            m_sampler.Wait();
+            Sample();
+        }
+
+        uint64 GetBaseline() const { return m_baseline; }
+        uint64 GetGrowth() const { return m_peak - m_baseline; }
+
+    private:
+        void Sample()
+        {
+            uint64 used = FPlatformMemory::GetStats().UsedPhysical;
+            uint64 peak = m_peak;
+
+            while (used > peak && !m_peak.compare_exchange_weak(peak, used))
+            {
+            }
+        }
+
+        uint64                  m_baseline;
+        std::atomic<uint64>     m_peak;
+        std::atomic<bool>       m_stop = false;
+        TFuture<void>           m_sampler;
+    };
+
+    template<typename Func>
+    void RunStage(const TCHAR* name, int scale, int iterations, int64 bytes, int64 items, TArray<StageResult>& results, Func&& func)
+    {
+        double best = DBL_MAX;
+        MemorySampler memory;
+
+        for (int i = 0; i < iterations; i++)
+        {
+            double start = FPlatformTime::Seconds();
+            func();
+            best = FMath::Min(best, FPlatformTime::Seconds() - start);
+        }
+
+        memory.Stop();
+
+        StageResult result;
+        result.name = name;
+        result.scale = scale;
+        result.seconds = best;
+        result.bytes = bytes;
+        result.items = items;
+        result.usedPhysical = memory.GetBaseline();
+        result.peakGrowth = memory.GetGrowth();
+        results.Add(result);
+
+        UE_LOG(LogQuakeImporter, Display, TEXT("%-28s x%-5d %10.3f ms %10.1f MB/s %14.0f items/s  +%6llu MB over %6llu MB"),
+            name, scale, best * 1000.0, (bytes / (1024.0 * 1024.0)) / FMath::Max(best, 1e-9), items / FMath::Max(best, 1e-9),
+            result.peakGrowth / (1024 * 1024), result.usedPhysical / (1024 * 1024));
+    }
+
+    // Record a stage that could not run so the report shows it missing instead of dropping it
+    void FailStage(const TCHAR* name, int scale, const TCHAR* reason, TArray<StageResult>& results)
+    {
+        StageResult result;
+        result.name = name;
+        result.scale = scale;
+        result.seconds = 0.0;
+        result.bytes = 0;
+        result.items = 0;
+        result.usedPhysical = 0;
+        result.peakGrowth = 0;
+        result.failed = true;
+        results.Add(result);
+
+        UE_LOG(LogQuakeImporter, Error, TEXT("%-28s x%-5d failed: %s"), name, scale, reason);
+    }
+
+    // The project settings would make runs incomparable, every option the stages read is fixed here.
+    // The import cache is off so each iteration does the full conversion.
+    void PinSettings(UQuakeImportSettings& settings)
+    {
+        settings.bUseImportCache = false;
+        settings.Collision = EBspCollision::Hull0;
+        settings.MaxCollisionElements = 1024;
+        settings.bRemoveHiddenSurfaces = true;
+        settings.bMergeCoplanarFaces = true;
+        settings.LightmapUVs = EBspLightmapUVs::QuakeLuxels;
+        settings.LightmapTexelSize = 16.0f;
+        settings.MinLightmapResolution = 16;
+        settings.MaxLightmapResolution = 2048;
+        settings.LightmapBudgetMB = 32.0f;
+        settings.VatEncoding = EAliasVatEncoding::Float16Delta;
+        settings.VatLayout = EAliasVatLayout::Tiled;
+        settings.bDeduplicatePoses = true;
+        settings.PoseReductionTolerance = 0.5f;
+    }
+
+    void BenchmarkBsp(int scale, int iterations, const TArray<QuakeCommon::QColor>& pal, TArray<StageResult>& results)
+    {
+        FRandomStream random(RANDOM_SEED);
+        TArray<uint8> file;
+        GenerateBsp(scale, random, file);
+
+        RunStage(TEXT("ReadTextureNames"), scale, iterations, file.Num(), BASE_BSP_TEXTURES * scale, results, [&]()
+        {
+            TArray<FString> names;
+            ReadTextureNames(file.GetData(), file.Num(), names);
+        });
+
+        BspLoader loader;
+        RunStage(TEXT("BspLoader::Load"), scale, 1, file.Num(), BASE_BSP_FACES * scale, results, [&]()
+        {
+            const uint8* data = file.GetData();
+            loader.Load(data);
+        });
+
+        if (!loader.GetBspPtr())
+        {
+            results.Last().failed = true;
+            UE_LOG(LogQuakeImporter, Error, TEXT("%-28s x%-5d failed: generated bsp rejected by the loader"), TEXT("BspLoader::Load"), scale);
+            return;
+        }
+
+        const bspformat29::Bsp_29& model = *loader.GetBspPtr();
+
+        TBitArray<> visible;
+        FindVisibleFaces(model, visible);
+
+        if (visible.CountSetBits() != model.submodels[0].numfaces)
+        {
+            UE_LOG(LogQuakeImporter, Warning, TEXT("Benchmark: %d of %d world faces visible, the synthetic tree is broken."), visible.CountSetBits(), model.submodels[0].numfaces);
+        }
+
+        RunStage(TEXT("DeserializeGroup"), scale, iterations, model.entities.Len() * sizeof(TCHAR), BASE_ENTITIES * scale, results, [&]()
+        {
+            TArray<AttributeGroup> entities;
+            DeserializeGroup(model.entities, entities);
+        });
+
+        RunStage(TEXT("HashSubmodel"), scale, iterations, file.Num(), model.faces.Num(), results, [&]()
+        {
+            for (int i = 0; i < model.submodels.Num(); i++)
+            {
+                HashSubmodel(model, i);
+            }
+        });
+
+        RunStage(TEXT("BuildSubmodelRawMesh"), scale, iterations, file.Num(), model.faces.Num(), results, [&]()
+        {
+            for (int i = 0; i < model.submodels.Num(); i++)
+            {
+                FRawMesh rawMesh;
+                TArray<FString> materials;
+                int lightmapResolution = 0;
+                BuildSubmodelRawMesh(model, i, 512, rawMesh, materials, lightmapResolution);
+            }
+        });
+
+        RunStage(TEXT("ComputeLightmapResolutions"), scale, iterations, file.Num(), model.faces.Num(), results, [&]()
+        {
+            TArray<int> resolutions;
+            ComputeLightmapResolutions(model, resolutions);
+        });
+
+        int64 hullBytes = model.nodes.Num() * sizeof(bspformat29::Node) + model.clipnodes.Num() * sizeof(bspformat29::ClipNode);
+
+        RunStage(TEXT("BuildHullRegions"), scale, iterations, hullBytes, model.nodes.Num() + model.clipnodes.Num(), results, [&]()
+        {
+            for (int hull = 0; hull < 2; hull++)
+            {
+                TArray<HullRegion> regions;
+                BuildHullRegions(model, 0, hull, ELeafContentType::Solid, 0.0f, regions);
+            }
+        });
+
+        TArray<AttributeGroup> entities;
+        DeserializeGroup(model.entities, entities);
+
+        // Editor world outside any package, nothing is saved
+        UWorld* world = UWorld::CreateWorld(EWorldType::Inactive, false, TEXT("QuakeImportBenchmark"), nullptr, true, ERHIFeatureLevel::Num);
+
+        RunStage(TEXT("EntityMaker spawn"), scale, 1, model.entities.Len() * sizeof(TCHAR), entities.Num(), results, [&]()
+        {
+            EntityMaker(*world, entities);
+        });
+
+        // Every actor matches its entity, the reimport path
+        RunStage(TEXT("EntityMaker reimport"), scale, iterations, model.entities.Len() * sizeof(TCHAR), entities.Num(), results, [&]()
+        {
+            EntityMaker(*world, entities);
+        });
+
+        world->DestroyWorld(false);
+        world->RemoveFromRoot();
+
+        int64 texels = (int64)model.textures.Num() * BSP_TEXTURE_SIZE * BSP_TEXTURE_SIZE;
+
+        RunStage(TEXT("ExpandPalette"), scale, iterations, texels, texels, results, [&]()
+        {
+            TArray<uint8> bgra;
+
+            for (const bspformat29::Texture& texture : model.textures)
+            {
+                QuakeCommon::ExpandPalette(texture.mip0, pal, bgra);
+            }
+        });
+    }
+
+    void BenchmarkMdl(int scale, int iterations, TArray<StageResult>& results)
+    {
+        FRandomStream random(RANDOM_SEED);
+        TArray<uint8> file;
+        GenerateMdl(scale, random, file);
+
+        TUniquePtr<Alias> model;
+        RunStage(TEXT("Alias parse"), scale, iterations, file.Num(), (int64)BASE_MDL_VERTS * scale * MDL_FRAMES, results, [&]()
+        {
+            const uint8* data = file.GetData();
+            model = MakeUnique<Alias>(TEXT("benchmark"), data, file.Num());
+        });
+
+        if (!model->IsValid())
+        {
+            results.Last().failed = true;
+            UE_LOG(LogQuakeImporter, Error, TEXT("%-28s x%-5d failed: generated mdl rejected by the parser"), TEXT("Alias parse"), scale);
+            return;
+        }
+
+        int64 poseBytes = (int64)model->m_numVerts * 4 * model->GetNumPoses();
+
+        RunStage(TEXT("BuildMeshStreams"), scale, iterations, model->m_numTris * sizeof(int) * 3, model->m_numTris, results, [&]()
+        {
+            AliasMeshStreams streams;
+            model->BuildMeshStreams(streams);
+        });
+
+        RunStage(TEXT("DecodePose"), scale, iterations, poseBytes, (int64)model->m_numVerts * model->GetNumPoses(), results, [&]()
+        {
+            TArray<FVector3f> positions;
+            TArray<FVector3f> normals;
+
+            for (uint32 i = 0; i < model->GetNumPoses(); i++)
+            {
+                model->DecodePose(model->GetPose(i), positions, normals, true);
+            }
+        });
+
+        const UQuakeImportSettings* settings = GetDefault<UQuakeImportSettings>();
+        AliasPoseRemap remap;
+
+        RunStage(TEXT("ReduceAliasPoses"), scale, iterations, poseBytes, model->GetNumPoses(), results, [&]()
+        {
+            ReduceAliasPoses(*model, settings->bDeduplicatePoses, settings->PoseReductionTolerance, remap);
+        });
+
+        VatLayout layout;
+
+        if (!ComputeVatLayout(*model, remap, layout))
+        {
+            FailStage(TEXT("BuildVat"), scale, TEXT("poses do not fit a VAT texture"), results);
+            return;
+        }
+
+        RunStage(TEXT("BuildVat"), scale, iterations, poseBytes, (int64)model->m_numVerts * remap.rows.Num(), results, [&]()
+        {
+            TArray<uint8> animationData;
+            TArray<uint8> normalData;
+            BuildAnimationData(*model, remap, layout, animationData);
+            BuildAnimationNormalData(*model, remap, layout, normalData);
+        });
+    }
+
+    void WriteResults(const TArray<StageResult>& results)
+    {
+        TArray<TSharedPtr<FJsonValue>> stages;
+
+        for (const StageResult& result : results)
+        {
+            TSharedRef<FJsonObject> stage = MakeShared<FJsonObject>();
+            stage->SetStringField(TEXT("stage"), result.name);
+            stage->SetNumberField(TEXT("scale"), result.scale);
+            stage->SetNumberField(TEXT("seconds"), result.seconds);
+            stage->SetNumberField(TEXT("bytes"), (double)result.bytes);
+            stage->SetNumberField(TEXT("items"), (double)result.items);
+            stage->SetNumberField(TEXT("usedPhysical"), (double)result.usedPhysical);
+            stage->SetNumberField(TEXT("peakGrowth"), (double)result.peakGrowth);
+            stage->SetBoolField(TEXT("failed"), result.failed);
+            stages.Add(MakeShared<FJsonValueObject>(stage));
+        }
+
+        TSharedRef<FJsonObject> report = MakeShared<FJsonObject>();
+        report->SetStringField(TEXT("time"), FDateTime::UtcNow().ToIso8601());
+        report->SetStringField(TEXT("platform"), FPlatformProperties::IniPlatformName());
+        report->SetStringField(TEXT("cpu"), FPlatformMisc::GetCPUBrand());
+        report->SetNumberField(TEXT("cores"), FPlatformMisc::NumberOfCores());
+        report->SetArrayField(TEXT("stages"), stages);
+
+        FString json;
+        TSharedRef<TJsonWriter<>> writer = TJsonWriterFactory<>::Create(&json);
+        FJsonSerializer::Serialize(report, writer);
+
+        FString filename = FPaths::ProjectSavedDir() / TEXT("QuakeImportBenchmark") / FDateTime::Now().ToString() + TEXT(".json");
+        FFileHelper::SaveStringToFile(json, *filename);
+
+        UE_LOG(LogQuakeImporter, Display, TEXT("Benchmark results written to %s"), *filename);
+    }
+}
+
+UQuakeImportBenchmarkCommandlet::UQuakeImportBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsEditor = true;
+    IsServer = false;
+    LogToConsole = true;
+}
+
+int32 UQuakeImportBenchmarkCommandlet::Main(const FString& Params)
+{
+    TArray<FString> tokens;
+    TArray<FString> switches;
+    TMap<FString, FString> params;
+    ParseCommandLine(*Params, tokens, switches, params);
+
+    TArray<int> scales = { 1, 10, 100, 1000 };
+
+    if (params.Contains(TEXT("Scales")))
+    {
+        TArray<FString> values;
+        params[TEXT("Scales")].ParseIntoArray(values, TEXT(","));
+        scales.Reset();
+
+        for (const FString& value : values)
+        {
+            scales.Add(FMath::Max(1, FCString::Atoi(*value)));
+        }
+    }
+
+    PinSettings(*GetMutableDefault<UQuakeImportSettings>());
+
+    int iterations = params.Contains(TEXT("Iterations")) ? FMath::Max(1, FCString::Atoi(*params[TEXT("Iterations")])) : 3;
+
+    // Gray ramp, the benchmark must not depend on the plugin content
+    TArray<QuakeCommon::QColor> pal;
+
+    for (int i = 0; i < 256; i++)
+    {
+        pal.Add({ (uint8)i, (uint8)i, (uint8)i });
+    }
+
+    TArray<StageResult> results;
+
+    for (int scale : scales)
+    {
+        BenchmarkBsp(scale, iterations, pal, results);
+        BenchmarkMdl(scale, iterations, results);
+    }
+
+    WriteResults(results);
+
+    return results.ContainsByPredicate([](const StageResult& result) { return result.failed; }) ? 1 : 0;
+}
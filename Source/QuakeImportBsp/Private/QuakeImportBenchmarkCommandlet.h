@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "QuakeImportBenchmarkCommandlet.generated.h"
+
+/*
+============================================
+UQuakeImportBenchmarkCommandlet
+
+Throughput and memory growth of the parsers and converters on synthetic
+BSP, MDL and entity data scaled from a stock map or model size.
+Runs headless with fixed import settings, entities are spawned in a
+transient world and no assets are created.
+
+UnrealEditor-Cmd Project.uproject -run=QuakeImportBenchmark [-Scales=1,10,100,1000] [-Iterations=3] -nullrhi
+
+Results go to the log and to Saved/QuakeImportBenchmark/<date>.json.
+Inputs come from a fixed seed so runs are comparable across machines and plugin versions.
+
+Memory is the peak used physical memory sampled during each stage, minus the
+memory in use when it started. Earlier stages and scales still leave the allocator
+warm, run one scale per process (-Scales=100) for numbers free of that.
+============================================
+*/
+
+UCLASS()
+class UQuakeImportBenchmarkCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UQuakeImportBenchmarkCommandlet();
+
+    // FROM UCOMMANDLET
+    virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,548 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "QuakeImportCommandlet.h"
+
+// Epic
+#include "AssetRegistry/IAssetRegistry.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
+
+// Quake Import
+#include "AliasFactory.h"
+#include "BspFactory.h"
+#include "BspUtilities.h"
+#include "GfxFactory.h"
+#include "ImportStats.h"
+#include "Pak.h"
+#include "QuakeCommon.h"
+#include "QuakeImportSettings.h"
+
+namespace
+{
+    // A file to import. Entries of a pak are addressed as <pak path>|<entry name>.
+    struct ImportItem
+    {
+        FString path;
+        int64   size;
+        FString output; // package named after the file, see GetOutputPackageName
+    };
+
+    const TCHAR* PAK_SEPARATOR = TEXT("|");
+
+    // Content folders the factories write to
+    const TCHAR* IMPORT_ROOTS[] = { TEXT("/Game/Maps"), TEXT("/Game/Models"), TEXT("/Game/Textures"), TEXT("/Game/Alias"), TEXT("/Game/Graphics") };
+
+    bool IsImportable(const FString& filename)
+    {
+        FString extension = FPaths::GetExtension(filename).ToLower();
+        FString baseName = FPaths::GetBaseFilename(filename).ToLower();
+
+        if (extension == TEXT("lmp"))
+        {
+            // not pictures
+            return baseName != TEXT("palette") && baseName != TEXT("colormap") && baseName != TEXT("pop");
+        }
+
+        return extension == TEXT("bsp") || extension == TEXT("mdl") || extension == TEXT("wad");
+    }
+
+    // Package the factory writes the item to. Files with the same base name in different mod
+    // directories or paks, like id1 and mission pack start.bsp, map to the same package.
+    FString GetOutputPackageName(const FString& filename)
+    {
+        FString extension = FPaths::GetExtension(filename).ToLower();
+        FString baseName = FPaths::GetBaseFilename(filename);
+
+        if (extension == TEXT("bsp"))
+        {
+            return TEXT("/Game/Maps/") / baseName;
+        }
+
+        if (extension == TEXT("mdl"))
+        {
+            return TEXT("/Game/Alias/") / baseName;
+        }
+
+        if (extension == TEXT("wad"))
+        {
+            return TEXT("/Game/Graphics/") / (baseName + TEXT("_atlas"));
+        }
+
+        return TEXT("/Game/Graphics/") / (baseName + TEXT("_color"));
+    }
+
+    void CollectItems(const FString& source, TArray<ImportItem>& out)
+    {
+        if (FPaths::DirectoryExists(source))
+        {
+            TArray<FString> files;
+            IFileManager::Get().FindFilesRecursive(files, *source, TEXT("*.*"), true, false);
+            files.Sort();
+
+            for (const FString& file : files)
+            {
+                if (FPaths::GetExtension(file).ToLower() == TEXT("pak"))
+                {
+                    CollectItems(file, out);
+                }
+                else if (IsImportable(file))
+                {
+                    out.Add({ file, IFileManager::Get().FileSize(*file), GetOutputPackageName(file) });
+                }
+            }
+
+            return;
+        }
+
+        TArray<uint8> data;
+
+        if (!FFileHelper::LoadFileToArray(data, *source))
+        {
+            UE_LOG(LogQuakeImporter, Error, TEXT("Can't read '%s'."), *source);
+            return;
+        }
+
+        Pak pak(data.GetData(), data.Num());
+
+        if (!pak.IsValid())
+        {
+            UE_LOG(LogQuakeImporter, Error, TEXT("'%s' is not a pak file."), *source);
+            return;
+        }
+
+        for (const PakEntry& entry : pak.m_entries)
+        {
+            if (IsImportable(entry.name))
+            {
+                out.Add({ source + PAK_SEPARATOR + entry.name, entry.filelen, GetOutputPackageName(entry.name) });
+            }
+        }
+    }
+
+    // Open paks are kept for the whole run, most items of a pak are imported in a row
+    bool LoadItem(const FString& path, TMap<FString, TArray<uint8>>& paks, TArray<uint8>& out)
+    {
+        FString pakPath;
+        FString entryName;
+
+        if (!path.Split(PAK_SEPARATOR, &pakPath, &entryName))
+        {
+            return FFileHelper::LoadFileToArray(out, *path);
+        }
+
+        TArray<uint8>* pakData = paks.Find(pakPath);
+
+        if (!pakData)
+        {
+            pakData = &paks.Add(pakPath);
+
+            if (!FFileHelper::LoadFileToArray(*pakData, *pakPath))
+            {
+                return false;
+            }
+        }
+
+        Pak pak(pakData->GetData(), pakData->Num());
+        const PakEntry* entry = pak.FindEntry(entryName);
+
+        if (!entry)
+        {
+            return false;
+        }
+
+        out.Reset();
+        out.Append(pak.GetEntryData(*entry), entry->filelen);
+        return true;
+    }
+
+    bool ImportItems(const TArray<FString>& paths)
+    {
+        TMap<FString, TArray<uint8>> paks;
+        TArray<uint8> data;
+        int failed = 0;
+
+        for (const FString& path : paths)
+        {
+            FString filename = path.Contains(PAK_SEPARATOR) ? path.RightChop(path.Find(PAK_SEPARATOR) + 1) : path;
+            FString extension = FPaths::GetExtension(filename).ToLower();
+            FName name(*FPaths::GetBaseFilename(filename));
+
+            if (!LoadItem(path, paks, data))
+            {
+                UE_LOG(LogQuakeImporter, Error, TEXT("Can't read '%s'."), *path);
+                failed++;
+                continue;
+            }
+
+            UFactory* factory = nullptr;
+
+            if (extension == TEXT("bsp"))
+            {
+                factory = NewObject<UBspFactory>();
+            }
+            else if (extension == TEXT("mdl"))
+            {
+                factory = NewObject<UAliasFactory>();
+            }
+            else
+            {
+                factory = NewObject<UGfxFactory>();
+            }
+
+            UE_LOG(LogQuakeImporter, Display, TEXT("Importing '%s'."), *path);
+
+            const uint8* buffer = data.GetData();
+
+            if (!factory->FactoryCreateBinary(nullptr, nullptr, name, RF_Public | RF_Standalone, nullptr, *extension, buffer, buffer + data.Num(), GWarn))
+            {
+                failed++;
+            }
+
+            // Drop the factory, the import session's transient objects and the assets already saved
+            CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+            UE_LOG(LogQuakeImporter, Log, TEXT("Resident memory after '%s': %.1f MB."), *path, FPlatformMemory::GetStats().UsedPhysical / (1024.0 * 1024.0));
+        }
+
+        return failed == 0;
+    }
+
+    // Keep one item per output package so no two imports, or two workers, write the same package.
+    // The item collected last wins, like a later pak or mod directory overrides id1 in Quake.
+    void ResolveOutputCollisions(TArray<ImportItem>& items)
+    {
+        TMap<FString, int> winners;
+
+        for (int i = 0; i < items.Num(); i++)
+        {
+            if (int* previous = winners.Find(items[i].output))
+            {
+                UE_LOG(LogQuakeImporter, Warning, TEXT("'%s' and '%s' both import to %s, keeping '%s'."),
+                    *items[*previous].path, *items[i].path, *items[i].output, *items[i].path);
+                *previous = i;
+            }
+            else
+            {
+                winners.Add(items[i].output, i);
+            }
+        }
+
+        TArray<ImportItem> kept;
+
+        for (int i = 0; i < items.Num(); i++)
+        {
+            if (winners[items[i].output] == i)
+            {
+                kept.Add(items[i]);
+            }
+        }
+
+        items = MoveTemp(kept);
+    }
+
+    // Balance the total file size per worker, largest files first. Items have distinct output
+    // packages after ResolveOutputCollisions, only textures and materials are shared.
+    void ShardItems(TArray<ImportItem> items, int numWorkers, TArray<TArray<FString>>& out)
+    {
+        items.StableSort([](const ImportItem& a, const ImportItem& b) { return a.size > b.size; });
+
+        TArray<int64> load;
+        load.SetNumZeroed(numWorkers);
+        out.SetNum(numWorkers);
+
+        for (const ImportItem& item : items)
+        {
+            int worker = 0;
+
+            for (int i = 1; i < numWorkers; i++)
+            {
+                if (load[i] < load[worker])
+                {
+                    worker = i;
+                }
+            }
+
+            out[worker].Add(item.path);
+            load[worker] += item.size;
+        }
+    }
+
+    // Maps share textures. The first worker to import a map using a texture owns its texture and material
+    // packages, the other workers still create them in memory for their references but never save them.
+    void AssignSharedPackages(const TArray<TArray<FString>>& shards, TArray<TSet<FString>>& outForeign)
+    {
+        QuakeCommon::ImportPackages texturePackages(bsputils::TEXTURE_PACKAGE_NAME);
+        QuakeCommon::ImportPackages materialPackages(bsputils::MATERIAL_PACKAGE_NAME);
+
+        TMap<FString, int> owners;
+        TMap<FString, TArray<uint8>> paks;
+        TArray<uint8> data;
+
+        for (int worker = 0; worker < shards.Num(); worker++)
+        {
+            for (const FString& path : shards[worker])
+            {
+                if (!path.EndsWith(TEXT(".bsp"), ESearchCase::IgnoreCase) || !LoadItem(path, paks, data))
+                {
+                    continue;
+                }
+
+                TArray<FString> textureNames;
+                bsputils::ReadTextureNames(data.GetData(), data.Num(), textureNames);
+
+                for (const FString& textureName : textureNames)
+                {
+                    // Every asset BspFactory may create for this miptex
+                    const FString packageNames[] = {
+                        texturePackages.GetPackageName(textureName + "_color"),
+                        texturePackages.GetPackageName(textureName + "_front_color"),
+                        texturePackages.GetPackageName(textureName + "_back_color"),
+                        materialPackages.GetPackageName(textureName)
+                    };
+
+                    for (const FString& packageName : packageNames)
+                    {
+                        if (!owners.Contains(packageName))
+                        {
+                            owners.Add(packageName, worker);
+                        }
+                    }
+                }
+            }
+        }
+
+        outForeign.SetNum(shards.Num());
+
+        for (const auto& it : owners)
+        {
+            for (int worker = 0; worker < shards.Num(); worker++)
+            {
+                if (worker != it.Value)
+                {
+                    outForeign[worker].Add(it.Key);
+                }
+            }
+        }
+    }
+
+    int32 RunWorker(const FString& manifestFile)
+    {
+        TArray<FString> lines;
+
+        if (!FFileHelper::LoadFileToStringArray(lines, *manifestFile))
+        {
+            UE_LOG(LogQuakeImporter, Error, TEXT("Can't read worker manifest '%s'."), *manifestFile);
+            return 1;
+        }
+
+        TArray<FString> paths;
+        TSet<FString> foreign;
+
+        for (const FString& line : lines)
+        {
+            FString type;
+            FString value;
+
+            if (!line.Split(TEXT(" "), &type, &value))
+            {
+                continue;
+            }
+
+            if (type == TEXT("import"))
+            {
+                paths.Add(value);
+            }
+            else if (type == TEXT("foreign"))
+            {
+                foreign.Add(value);
+            }
+        }
+
+        QuakeCommon::SetForeignPackages(foreign);
+
+        return ImportItems(paths) ? 0 : 1;
+    }
+}
+
+UQuakeImportCommandlet::UQuakeImportCommandlet()
+{
+    IsClient = false;
+    IsEditor = true;
+    IsServer = false;
+    LogToConsole = true;
+}
+
+int32 UQuakeImportCommandlet::Main(const FString& Params)
+{
+    TArray<FString> tokens;
+    TArray<FString> switches;
+    TMap<FString, FString> params;
+    ParseCommandLine(*Params, tokens, switches, params);
+
+    UQuakeImportSettings* settings = GetMutableDefault<UQuakeImportSettings>();
+    FString settingsFile = params.FindRef(TEXT("Settings"));
+
+    if (!settingsFile.IsEmpty())
+    {
+        settingsFile = FConfigCacheIni::NormalizeConfigIniPath(FPaths::ConvertRelativePathToFull(settingsFile));
+        GConfig->LoadFile(settingsFile);
+        settings->LoadConfig(nullptr, *settingsFile);
+    }
+
+    FString manifestFile = params.FindRef(TEXT("Manifest"));
+
+    if (!manifestFile.IsEmpty())
+    {
+        // Worker process, the coordinator already forced one asset per package
+        settings->PackageLayout = EQuakePackageLayout::OneAssetPerPackage;
+
+        FString reportFile = params.FindRef(TEXT("Report"));
+
+        if (!reportFile.IsEmpty())
+        {
+            QuakeCommon::ImportReport::SetFilename(reportFile);
+        }
+
+        return RunWorker(manifestFile);
+    }
+
+    FString source = params.FindRef(TEXT("Source"));
+
+    if (source.IsEmpty())
+    {
+        UE_LOG(LogQuakeImporter, Error, TEXT("Usage: -run=QuakeImport -Source=<dir or pak> [-Settings=<ini>] [-Workers=N]"));
+        return 1;
+    }
+
+    TArray<ImportItem> items;
+    CollectItems(FPaths::ConvertRelativePathToFull(source), items);
+    ResolveOutputCollisions(items);
+
+    if (!items.Num())
+    {
+        UE_LOG(LogQuakeImporter, Error, TEXT("Nothing to import in '%s'."), *source);
+        return 1;
+    }
+
+    int numWorkers = FPlatformMisc::NumberOfCores();
+
+    if (params.Contains(TEXT("Workers")))
+    {
+        numWorkers = FCString::Atoi(*params[TEXT("Workers")]);
+    }
+
+    numWorkers = FMath::Clamp(numWorkers, 1, items.Num());
+
+    double startTime = FPlatformTime::Seconds();
+    bool succeeded = true;
+
+    if (numWorkers == 1)
+    {
+        TArray<FString> paths;
+
+        for (const ImportItem& item : items)
+        {
+            paths.Add(item.path);
+        }
+
+        succeeded = ImportItems(paths);
+    }
+    else
+    {
+        // Workers write disjoint packages, which needs one package per asset
+        settings->PackageLayout = EQuakePackageLayout::OneAssetPerPackage;
+
+        TArray<TArray<FString>> shards;
+        ShardItems(items, numWorkers, shards);
+
+        TArray<TSet<FString>> foreign;
+        AssignSharedPackages(shards, foreign);
+
+        // Every worker instances the same masters, create them once before any worker needs them
+        QuakeCommon::CreateMasterMaterials();
+
+        FString manifestDir = FPaths::ProjectSavedDir() / TEXT("QuakeImport");
+        FString settingsArg = settingsFile.IsEmpty() ? FString() : FString::Printf(TEXT("-Settings=\"%s\""), *settingsFile);
+
+        TArray<FProcHandle> workers;
+        TArray<FString> reports;
+
+        for (int i = 0; i < numWorkers; i++)
+        {
+            TArray<FString> lines;
+
+            for (const FString& path : shards[i])
+            {
+                lines.Add(TEXT("import ") + path);
+            }
+
+            for (const FString& packageName : foreign[i])
+            {
+                lines.Add(TEXT("foreign ") + packageName);
+            }
+
+            FString manifest = manifestDir / FString::Printf(TEXT("Worker_%d.txt"), i);
+            FFileHelper::SaveStringArrayToFile(lines, *manifest);
+
+            // Import reports of the worker, appended to the shared file once it exits
+            FString report = manifestDir / FString::Printf(TEXT("Worker_%d.jsonl"), i);
+            IFileManager::Get().Delete(*report);
+            reports.Add(report);
+
+            FString args = FString::Printf(
+                TEXT("\"%s\" -run=QuakeImport -Manifest=\"%s\" -Report=\"%s\" %s -unattended -nopause -nosplash -nullrhi -abslog=\"%s\""),
+                *FPaths::GetProjectFilePath(),
+                *manifest,
+                *report,
+                *settingsArg,
+                *(manifestDir / FString::Printf(TEXT("Worker_%d.log"), i)));
+
+            FProcHandle handle = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *args, true, true, true, nullptr, 0, nullptr, nullptr);
+
+            if (!handle.IsValid())
+            {
+                UE_LOG(LogQuakeImporter, Error, TEXT("Failed to start import worker %d."), i);
+                succeeded = false;
+                continue;
+            }
+
+            UE_LOG(LogQuakeImporter, Display, TEXT("Worker %d: %d files."), i, shards[i].Num());
+            workers.Add(handle);
+        }
+
+        for (int i = 0; i < workers.Num(); i++)
+        {
+            FPlatformProcess::WaitForProc(workers[i]);
+
+            int32 returnCode = 0;
+            FPlatformProcess::GetProcReturnCode(workers[i], &returnCode);
+            FPlatformProcess::CloseProc(workers[i]);
+
+            if (returnCode != 0)
+            {
+                UE_LOG(LogQuakeImporter, Error, TEXT("Import worker %d failed (%d), see its log in %s."), i, returnCode, *manifestDir);
+                succeeded = false;
+            }
+        }
+
+        QuakeCommon::ImportReport::Merge(reports);
+
+        // Merge the worker results in this process view of the content
+        TArray<FString> roots;
+
+        for (const TCHAR* root : IMPORT_ROOTS)
+        {
+            roots.Add(root);
+        }
+
+        IAssetRegistry::GetChecked().ScanPathsSynchronous(roots, true);
+    }
+
+    UE_LOG(LogQuakeImporter, Display, TEXT("Imported %d files with %d workers in %.1fs."), items.Num(), numWorkers, FPlatformTime::Seconds() - startTime);
+
+    return succeeded ? 0 : 1;
+}
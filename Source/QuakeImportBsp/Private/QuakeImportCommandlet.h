@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "QuakeImportCommandlet.generated.h"
+
+/*
+============================================
+UQuakeImportCommandlet
+
+Headless batch import of a directory or a pak file.
+
+UnrealEditor-Cmd Project.uproject -run=QuakeImport -Source=<dir or pak> [-Settings=<ini>] [-Workers=N]
+
+Files are sharded over N worker processes writing disjoint packages,
+then the asset registry rescans the import paths. Workers are started
+with -Manifest=<file> listing their files and the packages they must not save.
+============================================
+*/
+
+UCLASS()
+class UQuakeImportCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UQuakeImportCommandlet();
+
+    // FROM UCOMMANDLET
+    virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RectPacker.h"
+
+RectPacker::RectPacker(int pageSize, int padding) :
+    m_pageSize(pageSize),
+    m_padding(padding)
+{
+    /* do nothing */
+}
+
+void RectPacker::Pack(const TArray<FIntPoint>& sizes, TArray<PackedRect>& out)
+{
+    out.SetNumUninitialized(sizes.Num());
+
+    TArray<int> order;
+    order.Reserve(sizes.Num());
+
+    for (int i = 0; i < sizes.Num(); i++)
+    {
+        order.Add(i);
+    }
+
+    order.Sort([&sizes](int a, int b)
+    {
+        return sizes[a].Y != sizes[b].Y ? sizes[a].Y > sizes[b].Y : sizes[a].X > sizes[b].X;
+    });
+
+    for (int index : order)
+    {
+        int width = sizes[index].X + m_padding * 2;
+        int height = sizes[index].Y + m_padding * 2;
+
+        Page* page = m_pages.Num() ? &m_pages.Last() : nullptr;
+
+        if (page && page->shelfX + width > page->size)
+        {
+            // next shelf
+            page->shelfY += page->shelfHeight;
+            page->shelfX = 0;
+            page->shelfHeight = 0;
+        }
+
+        if (!page || page->shelfX + width > page->size || page->shelfY + height > page->size)
+        {
+            Page newPage;
+            newPage.size = FMath::Max3(m_pageSize, width, height);
+            newPage.shelfX = 0;
+            newPage.shelfY = 0;
+            newPage.shelfHeight = 0;
+            newPage.used = FIntPoint(0, 0);
+            page = &m_pages.Add_GetRef(newPage);
+        }
+
+        out[index].page = m_pages.Num() - 1;
+        out[index].x = page->shelfX + m_padding;
+        out[index].y = page->shelfY + m_padding;
+
+        page->shelfX += width;
+        page->shelfHeight = FMath::Max(page->shelfHeight, height);
+        page->used.X = FMath::Max(page->used.X, page->shelfX);
+        page->used.Y = FMath::Max(page->used.Y, page->shelfY + height);
+    }
+}
+
+FIntPoint RectPacker::GetPageSize(int page) const
+{
+    return FIntPoint(
+        FMath::RoundUpToPowerOfTwo(m_pages[page].used.X),
+        FMath::RoundUpToPowerOfTwo(m_pages[page].used.Y));
+}
@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+============================================
+RectPacker
+
+Shelf packer placing rectangles on one or more square pages.
+Rectangles are sorted tallest first and laid left to right on shelves.
+============================================
+*/
+
+struct PackedRect
+{
+    int page;
+    int x;
+    int y;
+};
+
+class RectPacker
+{
+public:
+    RectPacker(int pageSize, int padding);
+
+    // Place every size, out matches the order of sizes. Rects bigger than a page get a page of their own.
+    void Pack(const TArray<FIntPoint>& sizes, TArray<PackedRect>& out);
+
+    int GetNumPages() const { return m_pages.Num(); }
+
+    // Used area of a page rounded up to a power of two
+    FIntPoint GetPageSize(int page) const;
+
+private:
+
+    struct Page
+    {
+        int size;
+        int shelfX;
+        int shelfY;
+        int shelfHeight;
+        FIntPoint used;
+    };
+
+    int m_pageSize;
+    int m_padding;
+    TArray<Page> m_pages;
+};
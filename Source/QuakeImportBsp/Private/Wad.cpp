@@ -0,0 +1,121 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Wad.h"
+#include "QuakeCommon.h"
+#include "ImportStats.h"
+
+namespace
+{
+    // conchars is stored as a raw 128x128 miptex lump without header
+    constexpr int CONCHARS_SIZE = 128;
+}
+
+Wad::Wad(const uint8* buf, int64 size) :
+    m_buf(buf),
+    m_size(size),
+    m_valid(false)
+{
+    QUAKE_IMPORT_SCOPE("ParseWad");
+
+    if (size < (int64)sizeof(WadHeader))
+    {
+        return;
+    }
+
+    WadHeader header;
+    QuakeCommon::ReadData<WadHeader>(buf, 0, header);
+
+    if (FMemory::Memcmp(header.identification, "WAD2", 4) != 0 ||
+        header.numlumps < 0 ||
+        header.infotableofs < 0 ||
+        header.infotableofs + (int64)header.numlumps * sizeof(WadLumpInfo) > size)
+    {
+        return;
+    }
+
+    m_lumps.Reserve(header.numlumps);
+
+    for (int i = 0; i < header.numlumps; i++)
+    {
+        WadLumpInfo info;
+        QuakeCommon::ReadData<WadLumpInfo>(buf, header.infotableofs + (i * sizeof(WadLumpInfo)), info);
+
+        if (info.compression != 0 || info.filepos < 0 || info.filepos + (int64)info.disksize > size)
+        {
+            continue; // never used by id, skip
+        }
+
+        char name[sizeof(info.name) + 1] = {};
+        FMemory::Memcpy(name, info.name, sizeof(info.name));
+
+        WadLump lump;
+        lump.name = FString(ANSI_TO_TCHAR(name)).ToLower();
+        lump.type = (uint8)info.type;
+        lump.filepos = info.filepos;
+        lump.size = info.disksize;
+        m_lumps.Add(lump);
+    }
+
+    m_valid = true;
+}
+
+const WadLump* Wad::FindLump(const FString& name) const
+{
+    return m_lumps.FindByPredicate([&name](const WadLump& lump) { return lump.name == name; });
+}
+
+void Wad::ReadImages(TArray<WadImage>& out) const
+{
+    QUAKE_IMPORT_SCOPE("ParseWad");
+
+    for (const WadLump& lump : m_lumps)
+    {
+        const uint8* in = GetLumpData(lump);
+
+        WadImage image;
+        image.name = lump.name;
+
+        if (lump.type == WAD_TYP_QPIC && lump.size >= (int)sizeof(int) * 2)
+        {
+            QuakeCommon::ReadData<int>(in, 0, image.width);
+            QuakeCommon::ReadData<int>(in, sizeof(int), image.height);
+            image.transparentIndex = 255;
+
+            if (image.width <= 0 || image.height <= 0 || (int64)sizeof(int) * 2 + (int64)image.width * image.height > lump.size)
+            {
+                continue;
+            }
+
+            image.data.Append(in + sizeof(int) * 2, image.width * image.height);
+        }
+        else if (lump.type == WAD_TYP_MIPTEX && lump.size == CONCHARS_SIZE * CONCHARS_SIZE)
+        {
+            image.width = CONCHARS_SIZE;
+            image.height = CONCHARS_SIZE;
+            image.transparentIndex = 0;
+            image.data.Append(in, lump.size);
+        }
+        else if (lump.type == WAD_TYP_MIPTEX && lump.size >= (int)sizeof(WadMiptex))
+        {
+            WadMiptex mt;
+            QuakeCommon::ReadData<WadMiptex>(in, 0, mt);
+
+            image.width = mt.width;
+            image.height = mt.height;
+            image.transparentIndex = -1;
+
+            if (image.width <= 0 || image.height <= 0 || (int64)mt.offsets[0] + (int64)image.width * image.height > lump.size)
+            {
+                continue;
+            }
+
+            image.data.Append(in + mt.offsets[0], image.width * image.height);
+        }
+        else
+        {
+            continue;
+        }
+
+        out.Add(image);
+    }
+}
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+============================================
+Wad
+
+WAD2 archive (gfx.wad). Indexes the lump directory and
+decodes the 2d graphics lumps.
+============================================
+*/
+
+// Lump types
+constexpr int WAD_TYP_PALETTE = 0x40;
+constexpr int WAD_TYP_QTEX = 0x41;
+constexpr int WAD_TYP_QPIC = 0x42;
+constexpr int WAD_TYP_SOUND = 0x43;
+constexpr int WAD_TYP_MIPTEX = 0x44;
+
+struct WadLump
+{
+    FString name;
+    int     type;
+    int     filepos;
+    int     size;
+};
+
+// Decoded 8 bit image
+struct WadImage
+{
+    FString         name;
+    int             width;
+    int             height;
+    int             transparentIndex; // palette index drawn as transparent, -1 for none
+    TArray<uint8>   data;
+};
+
+class Wad
+{
+public:
+    Wad(const uint8* buf, int64 size);
+
+    bool IsValid() const { return m_valid; }
+
+    TArray<WadLump> m_lumps;
+
+    // Decode every qpic and miptex lump
+    void ReadImages(TArray<WadImage>& out) const;
+
+    // Lump names are lower case
+    const WadLump* FindLump(const FString& name) const;
+    const uint8* GetLumpData(const WadLump& lump) const { return m_buf + lump.filepos; }
+
+private:
+
+    struct WadHeader
+    {
+        char    identification[4];
+        int     numlumps;
+        int     infotableofs;
+    };
+
+    struct WadLumpInfo
+    {
+        int     filepos;
+        int     disksize;
+        int     size;
+        char    type;
+        char    compression;
+        char    pad1;
+        char    pad2;
+        char    name[16];
+    };
+
+    struct WadMiptex
+    {
+        char        name[16];
+        unsigned    width;
+        unsigned    height;
+        unsigned    offsets[4];
+    };
+
+    const uint8*    m_buf;
+    int64           m_size;
+    bool            m_valid;
+};
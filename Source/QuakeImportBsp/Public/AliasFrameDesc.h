@@ -18,11 +18,23 @@ struct FAliasFrameDesc : public FTableRowBase
         int Type; // 0 single, 1 group
 
     UPROPERTY(EditAnywhere, BlueprintReadOnly)
-        int Start;
+        int Start; // VAT row
 
     UPROPERTY(EditAnywhere, BlueprintReadOnly)
         int NumPoses; // 1 for frames. Multiple for groups.
 
     UPROPERTY(EditAnywhere, BlueprintReadOnly)
         float Interval; // group only
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        int BlendTarget; // single frames dropped by pose reduction blend Start to BlendTarget. Equal to Start otherwise.
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        float BlendAlpha;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        FVector BoundsMin; // box of the frame poses in mesh space, for culling
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        FVector BoundsMax;
 };
\ No newline at end of file
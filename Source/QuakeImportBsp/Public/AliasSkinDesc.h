@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataTable.h"
+#include "AliasSkinDesc.generated.h"
+
+USTRUCT(BlueprintType)
+struct FAliasSkinDesc : public FTableRowBase
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        int Type; // 0 single, 1 group
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        int FirstSlice; // first slice in the _skins texture array
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        int NumFrames; // 1 for single skins
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        TArray<float> Intervals; // group only. End time of each frame, as in the mdl file.
+};
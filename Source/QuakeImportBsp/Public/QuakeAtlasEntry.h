@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataTable.h"
+#include "QuakeAtlasEntry.generated.h"
+
+class UTexture2D;
+
+// Where a wad lump was packed. Row name is the lump name.
+USTRUCT(BlueprintType)
+struct FQuakeAtlasEntry : public FTableRowBase
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        UTexture2D* Texture = nullptr;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        FVector2D UVMin = FVector2D::ZeroVector;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        FVector2D UVMax = FVector2D::ZeroVector;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        int Width = 0; // pixels
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly)
+        int Height = 0;
+};
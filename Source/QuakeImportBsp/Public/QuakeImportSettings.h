@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DeveloperSettings.h"
+#include "QuakeImportSettings.generated.h"
+
+// How alias pose positions are stored in the _animation texture
+UENUM()
+enum class EAliasVatEncoding : uint8
+{
+    // Pose delta from pose 0 as RGBA16F
+    Float16Delta,
+
+    // Original 8 bit packed positions in RGBA8. VatScale and VatOrigin material parameters unpack them.
+    Quantized8,
+
+    // Quantized8 positions with the mdl light normal index in alpha, one fetch per vertex and pose.
+    // The index addresses the 256x1 _normal_lut texture, no _normal texture.
+    PackedNormalIndex
+};
+
+// Where alias vertices and poses are placed in the VAT textures
+UENUM()
+enum class EAliasVatLayout : uint8
+{
+    // One row per pose, one column per vertex
+    Linear,
+
+    // Poses wrapped over several rows and placed side by side in a near square texture. Used automatically past 16384 vertices or poses.
+    Tiled
+};
+
+// Source of the lightmap UVs of the static meshes generated from bsp submodels
+UENUM()
+enum class EBspLightmapUVs : uint8
+{
+    // Unreal unwraps the mesh at build time
+    Generated,
+
+    // Faces laid out on their Quake luxel grid and packed at import, no unwrap at build time
+    QuakeLuxels
+};
+
+// How imported textures and materials are split into packages
+UENUM()
+enum class EQuakePackageLayout : uint8
+{
+    // Every texture in /Game/Textures/Textures, every material in /Game/Textures/Materials
+    SharedPackage,
+
+    // One package per asset. Only packages created or changed by an import are saved.
+    OneAssetPerPackage
+};
+
+// Collision of the static meshes generated from bsp submodels
+UENUM()
+enum class EBspCollision : uint8
+{
+    // No simple collision, queries use the render triangles
+    RenderMesh,
+
+    // Convex solids of the point hull, matches the visible geometry
+    Hull0,
+
+    // Convex solids of the player clip hull, expanded by the Quake player box like in game
+    Hull1
+};
+
+/*
+============================================
+UQuakeImportSettings
+
+Project wide import options. Project Settings > Plugins > Quake Import
+============================================
+*/
+
+UCLASS(MinimalAPI, config = Editor, defaultconfig, meta = (DisplayName = "Quake Import"))
+class UQuakeImportSettings : public UDeveloperSettings
+{
+    GENERATED_BODY()
+
+public:
+
+    UPROPERTY(config, EditAnywhere, Category = "Output")
+        EQuakePackageLayout PackageLayout = EQuakePackageLayout::SharedPackage;
+
+    // Reuse converted pixels, mesh streams and VAT data from Saved/QuakeImportCache when the source and settings match
+    UPROPERTY(config, EditAnywhere, Category = "Output")
+        bool bUseImportCache = true;
+
+    UPROPERTY(config, EditAnywhere, Category = "Bsp")
+        EBspCollision Collision = EBspCollision::Hull0;
+
+    // Meshes whose hull needs more convex elements keep the render mesh collision
+    UPROPERTY(config, EditAnywhere, Category = "Bsp", meta = (ClampMin = "1"))
+        int MaxCollisionElements = 1024;
+
+    // Drop world faces no player can see, from outside the map or inside solid brushes, and tool textured faces
+    UPROPERTY(config, EditAnywhere, Category = "Bsp")
+        bool bRemoveHiddenSurfaces = true;
+
+    // Merge adjacent faces on the same plane and texture, split by the Quake compiler for its lightmaps, before triangulation
+    UPROPERTY(config, EditAnywhere, Category = "Bsp")
+        bool bMergeCoplanarFaces = true;
+
+    UPROPERTY(config, EditAnywhere, Category = "Bsp")
+        EBspLightmapUVs LightmapUVs = EBspLightmapUVs::QuakeLuxels;
+
+    // Quake units covered by one lightmap texel. Lightmap resolution follows the lit surface area of each mesh.
+    UPROPERTY(config, EditAnywhere, Category = "Bsp", meta = (ClampMin = "1.0"))
+        float LightmapTexelSize = 16.0f;
+
+    UPROPERTY(config, EditAnywhere, Category = "Bsp", meta = (ClampMin = "4", ClampMax = "4096"))
+        int MinLightmapResolution = 16;
+
+    UPROPERTY(config, EditAnywhere, Category = "Bsp", meta = (ClampMin = "4", ClampMax = "4096"))
+        int MaxLightmapResolution = 2048;
+
+    // Lightmap memory of all the meshes of a map. The largest lightmaps are halved until it fits. 0 disables.
+    UPROPERTY(config, EditAnywhere, Category = "Bsp", meta = (ClampMin = "0.0"))
+        float LightmapBudgetMB = 32.0f;
+
+    // Spawn physics volumes over water, slime and lava
+    UPROPERTY(config, EditAnywhere, Category = "Bsp")
+        bool bLiquidVolumes = true;
+
+    // Fraction of a merged liquid volume allowed to cover non liquid space. Higher gives fewer, looser volumes.
+    UPROPERTY(config, EditAnywhere, Category = "Bsp", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+        float LiquidMergeTolerance = 0.05f;
+
+    UPROPERTY(config, EditAnywhere, Category = "Alias")
+        EAliasVatEncoding VatEncoding = EAliasVatEncoding::Float16Delta;
+
+    UPROPERTY(config, EditAnywhere, Category = "Alias")
+        EAliasVatLayout VatLayout = EAliasVatLayout::Linear;
+
+    // Bit exact duplicate poses share a single VAT row
+    UPROPERTY(config, EditAnywhere, Category = "Alias")
+        bool bDeduplicatePoses = true;
+
+    // Drop single frame poses a linear blend of their neighbours reproduces within this distance, in Quake units. 0 disables.
+    UPROPERTY(config, EditAnywhere, Category = "Alias", meta = (ClampMin = "0.0"))
+        float PoseReductionTolerance = 0.0f;
+
+    // Page size of the atlases built from wad files
+    UPROPERTY(config, EditAnywhere, Category = "Graphics", meta = (ClampMin = "64", ClampMax = "8192"))
+        int GfxAtlasSize = 1024;
+};
@@ -26,6 +26,7 @@ public class QuakeImport : ModuleRules
 			new string[]
 			{
 				"Core",
+				"DeveloperSettings",
 				// ... add other public dependencies that you statically link with here ...
 			}
 			);
@@ -42,8 +43,11 @@ public class QuakeImport : ModuleRules
                 		"AssetTools",
                 		"Projects",
                 		"RawMesh",
+                		"MeshDescription",
+                		"StaticMeshDescription",
                 		"AssetRegistry",
                 		"RenderCore",
+                		"Json",
                 		"RHI"
 				// ... add private dependencies that you statically link with here ...	
 			}